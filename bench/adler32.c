@@ -0,0 +1,78 @@
+#include "bench.h"
+#include "deflate.h"
+
+// Throughput of mz_adler32 compared to the scalar loop that tinfl used before the vector kernels
+
+#define BUFFER_LENGTH (16*1024*1024)
+#define CALL_BYTES (1024*1024)
+
+static mz_ulong scalar_adler32(mz_ulong adler, const unsigned char* ptr, size_t buf_len)
+{
+    mz_uint32 i, s1 = (mz_uint32) (adler & 0xffff), s2 = (mz_uint32) (adler >> 16);
+    size_t block_len = buf_len % 5552;
+
+    while (buf_len)
+    {
+        for (i = 0; i + 7 < block_len; i += 8, ptr += 8)
+        {
+            s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
+            s1 += ptr[4], s2 += s1; s1 += ptr[5], s2 += s1; s1 += ptr[6], s2 += s1; s1 += ptr[7], s2 += s1;
+        }
+        for ( ; i < block_len; ++i)
+            s1 += *ptr++, s2 += s1;
+        s1 %= 65521U, s2 %= 65521U;
+        buf_len -= block_len;
+        block_len = 5552;
+    }
+
+    return (s2 << 16) + s1;
+}
+
+static void print_result(const char* label, size_t bytes, double scalar, double vector)
+{
+    printf("%-20s scalar %6.0f MB/s, mz_adler32 %6.0f MB/s\n", label, bytes / 1e6 / scalar, bytes / 1e6 / vector);
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t sizes[] = { 16, 64, 256, 4096, 32768 };
+    unsigned char* buffer = (unsigned char*) malloc(BUFFER_LENGTH);
+    volatile mz_ulong sink;
+    double scalar, vector;
+    char label[64];
+    size_t i, k;
+
+    (void) argc;
+    (void) argv;
+
+    if (!buffer)
+        return 1;
+
+    bench_random(buffer, BUFFER_LENGTH, 1);
+
+    // Both implementations have to agree before their speed is compared
+    for (i = 0; i < 4096; i += 7)
+    {
+        if (mz_adler32(i, buffer + i, i * 3) != scalar_adler32(i, buffer + i, i * 3))
+        {
+            fprintf(stderr, "mz_adler32 does not match the scalar loop for %lu bytes.\n", (unsigned long) (i * 3));
+            return 1;
+        }
+    }
+
+    BENCH_BEST(scalar, BENCH_RUNS, sink = scalar_adler32(1, buffer, BUFFER_LENGTH));
+    BENCH_BEST(vector, BENCH_RUNS, sink = mz_adler32(1, buffer, BUFFER_LENGTH));
+    print_result("16 MB buffer", BUFFER_LENGTH, scalar, vector);
+
+    for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        BENCH_BEST(scalar, BENCH_RUNS, for (i = 0; i < CALL_BYTES; i += sizes[k]) sink = scalar_adler32(1, buffer + i, sizes[k]));
+        BENCH_BEST(vector, BENCH_RUNS, for (i = 0; i < CALL_BYTES; i += sizes[k]) sink = mz_adler32(1, buffer + i, sizes[k]));
+        sprintf(label, "%lu-byte calls", (unsigned long) sizes[k]);
+        print_result(label, CALL_BYTES, scalar, vector);
+    }
+
+    (void) sink;
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+// Has to be included before any other header for clock_gettime in strict C modes
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Helpers shared by the microbenchmarks, every measurement is the best of several runs to reduce the noise
+
+#define BENCH_RUNS 7
+
+// Not every benchmark uses every helper
+#ifdef __GNUC__
+#define BENCH_HELPER static __attribute__((unused))
+#else
+#define BENCH_HELPER static
+#endif
+
+#if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
+#include <windows.h>
+
+BENCH_HELPER double bench_now(void)
+{
+    LARGE_INTEGER counter, frequency;
+
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (double) counter.QuadPart / (double) frequency.QuadPart;
+}
+#else
+#include <time.h>
+
+BENCH_HELPER double bench_now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (double) t.tv_sec + (double) t.tv_nsec * 1e-9;
+}
+#endif
+
+// Runs the statement the given number of times and stores the shortest time in seconds
+#define BENCH_BEST(BEST, RUNS, STATEMENT) \
+    { \
+        int bench_run; \
+        (BEST) = 1e30; \
+        for (bench_run = 0; bench_run < (RUNS); bench_run++) \
+        { \
+            double bench_start = bench_now(), bench_time; \
+            STATEMENT; \
+            bench_time = bench_now() - bench_start; \
+            if (bench_time < (BEST)) \
+                (BEST) = bench_time; \
+        } \
+    }
+
+// Fills the buffer with the same pseudo-random bytes on every platform
+BENCH_HELPER void bench_random(unsigned char* buffer, size_t len, unsigned int seed)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        buffer[i] = (unsigned char) (seed >> 16);
+    }
+}
+
+#endif
@@ -0,0 +1,56 @@
+#include "bench.h"
+#include <string.h>
+#include "bench_resources.c"
+
+// Time to decompress whole multi-megabyte resources: copy_resource and copy_into decode directly into the
+// destination, the chunks of get_resource go through the 32 KB window and are copied, as copy_resource used to do
+
+typedef struct chunk_state { char* buffer; size_t length; } chunk_state;
+
+static int append_chunk(const void* buffer, int len, void *user)
+{
+    chunk_state* state = (chunk_state*) user;
+
+    memcpy(state->buffer + state->length, buffer, len);
+    state->length += len;
+    return 1;
+}
+
+int main(int argc, char** argv)
+{
+    static const char* names[] = { "mixed.bin", "text.bin", "stored.bin" };
+    chunk_state state;
+    double window, copy, into;
+    size_t compressed, length, k;
+    char* buffer = NULL;
+    int failed = 0;
+
+    (void) argc;
+    (void) argv;
+
+    for (k = 0; k < sizeof(names) / sizeof(names[0]); k++)
+    {
+        if (!rescue_get_length(names[k], &compressed, &length))
+            return 1;
+
+        state.buffer = (char*) malloc(length);
+        if (!state.buffer)
+            return 1;
+
+        BENCH_BEST(window, BENCH_RUNS, state.length = 0; failed |= !rescue_get_resource(names[k], &append_chunk, &state));
+        BENCH_BEST(copy, BENCH_RUNS, failed |= !rescue_copy_resource(names[k], &buffer, &length); free(buffer));
+        BENCH_BEST(into, BENCH_RUNS, failed |= !rescue_copy_into(names[k], state.buffer, length, &length));
+
+        if (failed)
+        {
+            fprintf(stderr, "Unable to decompress %s.\n", names[k]);
+            return 1;
+        }
+
+        printf("%-10s %5.1f MB (%3.0f%%): window %7.2f ms, copy_resource %7.2f ms (%5.0f MB/s), copy_into %7.2f ms\n",
+            names[k], length / 1e6, 100.0 * compressed / length, window * 1e3, copy * 1e3, length / 1e6 / copy, into * 1e3);
+        free(state.buffer);
+    }
+
+    return 0;
+}
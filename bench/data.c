@@ -0,0 +1,75 @@
+#include "bench.h"
+#include <string.h>
+
+// Writes reproducible input files for the benchmarks that need resources: `text` is made of words and compresses
+// well, `random` does not compress and `mixed` alternates between both in chunks of 64 KB.
+
+#define CHUNK_LENGTH (64*1024)
+
+static const char* words[] = {
+    "resource", "compiler", "static", "const", "char", "buffer", "length", "return", "the", "of", "and", "data",
+    "file", "name", "void", "size_t", "int", "struct", "window", "block", "{", "}", "(", ")", ";", "=", "if", "for"
+};
+
+static void text_chunk(unsigned char* buffer, size_t len, unsigned int* seed)
+{
+    size_t i = 0, line = 0;
+
+    while (i < len)
+    {
+        const char* word;
+        size_t n;
+
+        *seed = *seed * 1103515245u + 12345u;
+        word = words[(*seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+        n = strlen(word);
+
+        for ( ; *word && i < len; i++)
+            buffer[i] = (unsigned char) *(word++);
+        if (i < len)
+            buffer[i++] = (line += n + 1) > 72 ? '\n' : ' ';
+        if (line > 72)
+            line = 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned char* buffer;
+    unsigned int seed = 1;
+    size_t total, i;
+    FILE* fp;
+
+    if (argc != 4 || (strcmp(argv[2], "text") != 0 && strcmp(argv[2], "random") != 0 && strcmp(argv[2], "mixed") != 0))
+    {
+        fprintf(stderr, "Usage: bench_data <path> text|random|mixed <megabytes>\n");
+        return 1;
+    }
+
+    total = (size_t) atol(argv[3]) * 1024 * 1024;
+    buffer = (unsigned char*) malloc(CHUNK_LENGTH);
+    fp = fopen(argv[1], "wb");
+
+    if (!buffer || !fp)
+    {
+        fprintf(stderr, "Unable to write to file %s.\n", argv[1]);
+        return 1;
+    }
+
+    for (i = 0; i < total; i += CHUNK_LENGTH)
+    {
+        if (strcmp(argv[2], "text") == 0 || (strcmp(argv[2], "mixed") == 0 && (i / CHUNK_LENGTH) % 2 == 0))
+            text_chunk(buffer, CHUNK_LENGTH, &seed);
+        else
+            bench_random(buffer, CHUNK_LENGTH, seed += (unsigned int) i);
+
+        if (fwrite(buffer, 1, CHUNK_LENGTH, fp) != CHUNK_LENGTH)
+        {
+            fprintf(stderr, "Unable to write to file %s.\n", argv[1]);
+            return 1;
+        }
+    }
+
+    free(buffer);
+    return fclose(fp) != 0;
+}
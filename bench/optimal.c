@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "deflate.h"
+
+// Size and time of the optimal parsing compared to the default parsing with the maximal number of probes (-l 10)
+
+static const char* default_inputs[] = { BENCH_SOURCE_DIR "deflate.c", BENCH_SOURCE_DIR "inflate.c", BENCH_SOURCE_DIR "rescue.c",
+    BENCH_SOURCE_DIR "template.c" };
+
+static mz_bool count_output(const void* data, int len, void *user)
+{
+    (void) data;
+    *(size_t*) user += len;
+    return 1;
+}
+
+static size_t compress_size(tdefl_compressor* compressor, const char* data, size_t len, int flags, double* time)
+{
+    size_t total = 0;
+    double start = bench_now();
+
+    tdefl_init(compressor, &count_output, &total, flags);
+    tdefl_compress_buffer(compressor, data, len, TDEFL_FINISH);
+    *time = bench_now() - start;
+
+    return total;
+}
+
+int main(int argc, char** argv)
+{
+    tdefl_compressor* compressor = (tdefl_compressor*) malloc(sizeof(tdefl_compressor));
+    const char** inputs = argc > 1 ? (const char**) argv + 1 : default_inputs;
+    int count = argc > 1 ? argc - 1 : (int) (sizeof(default_inputs) / sizeof(default_inputs[0]));
+    size_t len, normal, optimal;
+    double normal_time, optimal_time;
+    char* data;
+    FILE* fp;
+    int i;
+
+    if (!compressor)
+        return 1;
+
+    for (i = 0; i < count; i++)
+    {
+        fp = fopen(inputs[i], "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "Unable to read file %s.\n", inputs[i]);
+            return 1;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        len = (size_t) ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        data = (char*) malloc(len + 1);
+
+        if (!data || fread(data, 1, len, fp) != len)
+        {
+            fprintf(stderr, "Unable to read file %s.\n", inputs[i]);
+            return 1;
+        }
+        fclose(fp);
+
+        normal = compress_size(compressor, data, len, TDEFL_MAX_PROBES_MASK, &normal_time);
+        optimal = compress_size(compressor, data, len, TDEFL_MAX_PROBES_MASK | TDEFL_OPTIMAL_PARSING_FLAG, &optimal_time);
+
+        printf("%-40s %9lu -> %9lu (%.0f ms) vs. %9lu (%.0f ms, %+.1f%%)\n", inputs[i], (unsigned long) len,
+            (unsigned long) normal, normal_time * 1e3, (unsigned long) optimal, optimal_time * 1e3, 100.0 * ((double) optimal / normal - 1.0));
+        free(data);
+    }
+
+    free(compressor);
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "deflate.h"
+
+// Size and speed of compressing a resource in 128-byte pieces that are each sync-flushed, as rescue used to do,
+// compared to 4 MB pieces without flushes until the end of the stream
+
+#define SYNC_PIECE 128
+#define STREAM_PIECE (4*1024*1024)
+
+static const char* default_inputs[] = { BENCH_DATA_DIR "mixed.bin", BENCH_DATA_DIR "text.bin", BENCH_DATA_DIR "stored.bin" };
+
+static mz_bool count_output(const void* data, int len, void *user)
+{
+    (void) data;
+    *(size_t*) user += len;
+    return 1;
+}
+
+static size_t compress_pieces(tdefl_compressor* compressor, const char* data, size_t len, size_t piece, tdefl_flush flush, double* time)
+{
+    size_t total = 0, position;
+    double start = bench_now();
+
+    tdefl_init(compressor, &count_output, &total, TDEFL_MAX_PROBES_MASK);
+
+    for (position = 0; position < len; position += piece)
+        tdefl_compress_buffer(compressor, data + position, (len - position < piece) ? len - position : piece, flush);
+
+    tdefl_compress_buffer(compressor, NULL, 0, TDEFL_FINISH);
+    *time = bench_now() - start;
+
+    return total;
+}
+
+int main(int argc, char** argv)
+{
+    tdefl_compressor* compressor = (tdefl_compressor*) malloc(sizeof(tdefl_compressor));
+    const char** inputs = argc > 1 ? (const char**) argv + 1 : default_inputs;
+    int count = argc > 1 ? argc - 1 : (int) (sizeof(default_inputs) / sizeof(default_inputs[0]));
+    size_t len, sync, stream;
+    double sync_time, stream_time;
+    char* data;
+    FILE* fp;
+    int i;
+
+    if (!compressor)
+        return 1;
+
+    for (i = 0; i < count; i++)
+    {
+        fp = fopen(inputs[i], "rb");
+        if (!fp)
+        {
+            fprintf(stderr, "Unable to read file %s.\n", inputs[i]);
+            return 1;
+        }
+
+        fseek(fp, 0, SEEK_END);
+        len = (size_t) ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        data = (char*) malloc(len + 1);
+
+        if (!data || fread(data, 1, len, fp) != len)
+        {
+            fprintf(stderr, "Unable to read file %s.\n", inputs[i]);
+            return 1;
+        }
+        fclose(fp);
+
+        sync = compress_pieces(compressor, data, len, SYNC_PIECE, TDEFL_SYNC_FLUSH, &sync_time);
+        stream = compress_pieces(compressor, data, len, STREAM_PIECE, TDEFL_NO_FLUSH, &stream_time);
+
+        printf("%-40s %9lu -> %9lu (%.1f%%, %.1f MB/s) vs. %9lu (%.1f%%, %.1f MB/s)\n", inputs[i], (unsigned long) len,
+            (unsigned long) sync, 100.0 * sync / len, len / 1e6 / sync_time,
+            (unsigned long) stream, 100.0 * stream / len, len / 1e6 / stream_time);
+        free(data);
+    }
+
+    free(compressor);
+    return 0;
+}
@@ -29,21 +29,6 @@
   #define MZ_FORCEINLINE inline
 #endif
 
-mz_ulong tdefl_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len)
-{
-  mz_uint32 i, s1 = (mz_uint32)(adler & 0xffff), s2 = (mz_uint32)(adler >> 16); size_t block_len = buf_len % 5552;
-  if (!ptr) return MZ_ADLER32_INIT;
-  while (buf_len) {
-    for (i = 0; i + 7 < block_len; i += 8, ptr += 8) {
-      s1 += ptr[0], s2 += s1; s1 += ptr[1], s2 += s1; s1 += ptr[2], s2 += s1; s1 += ptr[3], s2 += s1;
-      s1 += ptr[4], s2 += s1; s1 += ptr[5], s2 += s1; s1 += ptr[6], s2 += s1; s1 += ptr[7], s2 += s1;
-    }
-    for ( ; i < block_len; ++i) s1 += *ptr++, s2 += s1;
-    s1 %= 65521U, s2 %= 65521U; buf_len -= block_len; block_len = 5552;
-  }
-  return (s2 << 16) + s1;
-}
-
 // Purposely making these tables static for faster init and thread safety.
 static const mz_uint16 s_tdefl_len_sym[256] = {
   257,258,259,260,261,262,263,264,265,265,266,266,267,267,268,268,269,269,269,269,270,270,270,270,271,271,271,271,272,272,272,272,
@@ -149,30 +134,33 @@ static void tdefl_huffman_enforce_max_code_size(int *pNum_codes, int code_list_l
   }
 }
 
-static void tdefl_optimize_huffman_table(tdefl_compressor *d, int table_num, int table_len, int code_size_limit, int static_table)
+// Calculates the code sizes of a Huffman table for the given symbol counts, limited to code_size_limit bits.
+static void tdefl_huffman_code_sizes(const mz_uint16 *pSym_count, int table_len, int code_size_limit, mz_uint8 *pCode_sizes)
 {
-  int i, j, l, num_codes[1 + TDEFL_MAX_SUPPORTED_HUFF_CODESIZE]; mz_uint next_code[TDEFL_MAX_SUPPORTED_HUFF_CODESIZE + 1]; MZ_CLEAR_OBJ(num_codes);
-  if (static_table)
-  {
-    for (i = 0; i < table_len; i++) num_codes[d->m_huff_code_sizes[table_num][i]]++;
-  }
-  else
-  {
-    tdefl_sym_freq syms0[TDEFL_MAX_HUFF_SYMBOLS], syms1[TDEFL_MAX_HUFF_SYMBOLS], *pSyms;
-    int num_used_syms = 0;
-    const mz_uint16 *pSym_count = &d->m_huff_count[table_num][0];
-    for (i = 0; i < table_len; i++) if (pSym_count[i]) { syms0[num_used_syms].m_key = (mz_uint16)pSym_count[i]; syms0[num_used_syms++].m_sym_index = (mz_uint16)i; }
+  int i, j, l, num_codes[1 + TDEFL_MAX_SUPPORTED_HUFF_CODESIZE], num_used_syms = 0;
+  tdefl_sym_freq syms0[TDEFL_MAX_HUFF_SYMBOLS], syms1[TDEFL_MAX_HUFF_SYMBOLS], *pSyms; MZ_CLEAR_OBJ(num_codes);
+  for (i = 0; i < table_len; i++) if (pSym_count[i]) { syms0[num_used_syms].m_key = (mz_uint16)pSym_count[i]; syms0[num_used_syms++].m_sym_index = (mz_uint16)i; }
 
-    pSyms = tdefl_radix_sort_syms(num_used_syms, syms0, syms1); tdefl_calculate_minimum_redundancy(pSyms, num_used_syms);
+  pSyms = tdefl_radix_sort_syms(num_used_syms, syms0, syms1); tdefl_calculate_minimum_redundancy(pSyms, num_used_syms);
 
-    for (i = 0; i < num_used_syms; i++) num_codes[pSyms[i].m_key]++;
+  for (i = 0; i < num_used_syms; i++) num_codes[pSyms[i].m_key]++;
 
-    tdefl_huffman_enforce_max_code_size(num_codes, num_used_syms, code_size_limit);
+  tdefl_huffman_enforce_max_code_size(num_codes, num_used_syms, code_size_limit);
 
+  memset(pCode_sizes, 0, table_len);
+  for (i = 1, j = num_used_syms; i <= code_size_limit; i++)
+    for (l = num_codes[i]; l > 0; l--) pCode_sizes[pSyms[--j].m_sym_index] = (mz_uint8)(i);
+}
+
+static void tdefl_optimize_huffman_table(tdefl_compressor *d, int table_num, int table_len, int code_size_limit, int static_table)
+{
+  int i, j, l, num_codes[1 + TDEFL_MAX_SUPPORTED_HUFF_CODESIZE]; mz_uint next_code[TDEFL_MAX_SUPPORTED_HUFF_CODESIZE + 1]; MZ_CLEAR_OBJ(num_codes);
+  if (!static_table)
+  {
     MZ_CLEAR_OBJ(d->m_huff_code_sizes[table_num]); MZ_CLEAR_OBJ(d->m_huff_codes[table_num]);
-    for (i = 1, j = num_used_syms; i <= code_size_limit; i++)
-      for (l = num_codes[i]; l > 0; l--) d->m_huff_code_sizes[table_num][pSyms[--j].m_sym_index] = (mz_uint8)(i);
+    tdefl_huffman_code_sizes(&d->m_huff_count[table_num][0], table_len, code_size_limit, d->m_huff_code_sizes[table_num]);
   }
+  for (i = 0; i < table_len; i++) num_codes[d->m_huff_code_sizes[table_num][i]]++;
 
   next_code[1] = 0; for (j = 0, i = 2; i <= code_size_limit; i++) next_code[i] = j = ((j + num_codes[i - 1]) << 1);
 
@@ -214,22 +202,11 @@ static void tdefl_optimize_huffman_table(tdefl_compressor *d, int table_num, int
 
 static mz_uint8 s_tdefl_packed_code_size_syms_swizzle[] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
 
-static void tdefl_start_dynamic_block(tdefl_compressor *d)
+// Run-length codes the code sizes of the literal/length and distance tables for a dynamic block header and counts
+// the symbols of the packed sizes in the third table. Returns the number of packed code sizes.
+static mz_uint tdefl_pack_code_sizes(tdefl_compressor *d, const mz_uint8 *code_sizes_to_pack, mz_uint total_code_sizes_to_pack, mz_uint8 *packed_code_sizes)
 {
-  int num_lit_codes, num_dist_codes, num_bit_lengths; mz_uint i, total_code_sizes_to_pack, num_packed_code_sizes, rle_z_count, rle_repeat_count, packed_code_sizes_index;
-  mz_uint8 code_sizes_to_pack[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1], packed_code_sizes[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1], prev_code_size = 0xFF;
-
-  d->m_huff_count[0][256] = 1;
-
-  tdefl_optimize_huffman_table(d, 0, TDEFL_MAX_HUFF_SYMBOLS_0, 15, MZ_FALSE);
-  tdefl_optimize_huffman_table(d, 1, TDEFL_MAX_HUFF_SYMBOLS_1, 15, MZ_FALSE);
-
-  for (num_lit_codes = 286; num_lit_codes > 257; num_lit_codes--) if (d->m_huff_code_sizes[0][num_lit_codes - 1]) break;
-  for (num_dist_codes = 30; num_dist_codes > 1; num_dist_codes--) if (d->m_huff_code_sizes[1][num_dist_codes - 1]) break;
-
-  memcpy(code_sizes_to_pack, &d->m_huff_code_sizes[0][0], num_lit_codes);
-  memcpy(code_sizes_to_pack + num_lit_codes, &d->m_huff_code_sizes[1][0], num_dist_codes);
-  total_code_sizes_to_pack = num_lit_codes + num_dist_codes; num_packed_code_sizes = 0; rle_z_count = 0; rle_repeat_count = 0;
+  mz_uint i, num_packed_code_sizes = 0, rle_z_count = 0, rle_repeat_count = 0; mz_uint8 prev_code_size = 0xFF;
 
   memset(&d->m_huff_count[2][0], 0, sizeof(d->m_huff_count[2][0]) * TDEFL_MAX_HUFF_SYMBOLS_2);
   for (i = 0; i < total_code_sizes_to_pack; i++)
@@ -257,6 +234,27 @@ static void tdefl_start_dynamic_block(tdefl_compressor *d)
   }
   if (rle_repeat_count) { TDEFL_RLE_PREV_CODE_SIZE(); } else { TDEFL_RLE_ZERO_CODE_SIZE(); }
 
+  return num_packed_code_sizes;
+}
+
+static void tdefl_start_dynamic_block(tdefl_compressor *d)
+{
+  int num_lit_codes, num_dist_codes, num_bit_lengths; mz_uint i, total_code_sizes_to_pack, num_packed_code_sizes, packed_code_sizes_index;
+  mz_uint8 code_sizes_to_pack[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1], packed_code_sizes[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1];
+
+  d->m_huff_count[0][256] = 1;
+
+  tdefl_optimize_huffman_table(d, 0, TDEFL_MAX_HUFF_SYMBOLS_0, 15, MZ_FALSE);
+  tdefl_optimize_huffman_table(d, 1, TDEFL_MAX_HUFF_SYMBOLS_1, 15, MZ_FALSE);
+
+  for (num_lit_codes = 286; num_lit_codes > 257; num_lit_codes--) if (d->m_huff_code_sizes[0][num_lit_codes - 1]) break;
+  for (num_dist_codes = 30; num_dist_codes > 1; num_dist_codes--) if (d->m_huff_code_sizes[1][num_dist_codes - 1]) break;
+
+  memcpy(code_sizes_to_pack, &d->m_huff_code_sizes[0][0], num_lit_codes);
+  memcpy(code_sizes_to_pack + num_lit_codes, &d->m_huff_code_sizes[1][0], num_dist_codes);
+  total_code_sizes_to_pack = num_lit_codes + num_dist_codes;
+  num_packed_code_sizes = tdefl_pack_code_sizes(d, code_sizes_to_pack, total_code_sizes_to_pack, packed_code_sizes);
+
   tdefl_optimize_huffman_table(d, 2, TDEFL_MAX_HUFF_SYMBOLS_2, 7, MZ_FALSE);
 
   TDEFL_PUT_BITS(2, 2);
@@ -894,6 +892,332 @@ static mz_bool tdefl_compress_normal(tdefl_compressor *d)
   return MZ_TRUE;
 }
 
+// Optimal parsing. The input is collected in windows of TDEFL_OPT_WINDOW_SIZE bytes after up to TDEFL_LZ_DICT_SIZE bytes of
+// history. A window is parsed as a shortest path through its positions: a literal and a match of every length that the
+// match finder sees are edges weighted by their estimated size in bits. The first pass weights them by the static codes,
+// every following pass by the entropy of the symbols chosen in the pass before, and the path of the smallest block wins.
+typedef struct { float m_lit[TDEFL_MAX_HUFF_SYMBOLS_0], m_dist[TDEFL_MAX_HUFF_SYMBOLS_1], m_len[TDEFL_MAX_MATCH_LEN + 1]; } tdefl_opt_costs;
+typedef struct { mz_uint32 m_lit[TDEFL_MAX_HUFF_SYMBOLS_0], m_dist[TDEFL_MAX_HUFF_SYMBOLS_1], m_extra_bits, m_codes, m_matches; } tdefl_opt_stats;
+
+#define TDEFL_OPT_HASH(p) ((((p)[0] << (TDEFL_LZ_HASH_SHIFT * 2)) ^ ((p)[1] << TDEFL_LZ_HASH_SHIFT) ^ (p)[2]) & (TDEFL_LZ_HASH_SIZE - 1))
+
+// Base 2 logarithm of a positive integer from its exponent and a short series for the mantissa, good to about 1e-4 bits.
+static float tdefl_opt_log2(mz_uint32 x)
+{
+  float m = (float)x, t, t2; int e = 0;
+  while (m >= 2.0f) { m *= 0.5f; e++; }
+  t = (m - 1.0f) / (m + 1.0f); t2 = t * t;
+  return (float)e + 2.88539008f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+}
+
+static void tdefl_opt_entropy(const mz_uint32 *pCount, mz_uint num_syms, float *pCost)
+{
+  mz_uint i; mz_uint32 total = 0; float log2_total;
+  for (i = 0; i < num_syms; i++) total += pCount[i];
+  log2_total = tdefl_opt_log2(MZ_MAX(total, 1));
+  // Symbols that were not used cost as much as a symbol that was used once
+  for (i = 0; i < num_syms; i++) pCost[i] = log2_total - (pCount[i] ? tdefl_opt_log2(pCount[i]) : 0.0f);
+}
+
+static void tdefl_opt_set_costs(tdefl_opt_costs *pCosts, const tdefl_opt_stats *pStats)
+{
+  mz_uint i;
+  if (!pStats)
+  {
+    for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_0; i++) pCosts->m_lit[i] = (i <= 143) ? 8.0f : (i <= 255) ? 9.0f : (i <= 279) ? 7.0f : 8.0f;
+    for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_1; i++) pCosts->m_dist[i] = 5.0f;
+  }
+  else
+  {
+    tdefl_opt_entropy(pStats->m_lit, TDEFL_MAX_HUFF_SYMBOLS_0, pCosts->m_lit);
+    tdefl_opt_entropy(pStats->m_dist, TDEFL_MAX_HUFF_SYMBOLS_1, pCosts->m_dist);
+  }
+  for (i = TDEFL_MIN_MATCH_LEN; i <= TDEFL_MAX_MATCH_LEN; i++) pCosts->m_len[i] = pCosts->m_lit[s_tdefl_len_sym[i - TDEFL_MIN_MATCH_LEN]] + s_tdefl_len_extra[i - TDEFL_MIN_MATCH_LEN];
+}
+
+static MZ_FORCEINLINE float tdefl_opt_dist_cost(const tdefl_opt_costs *pCosts, mz_uint match_dist)
+{
+  match_dist -= 1;
+  if (match_dist < 512) return pCosts->m_dist[s_tdefl_small_dist_sym[match_dist]] + s_tdefl_small_dist_extra[match_dist];
+  return pCosts->m_dist[s_tdefl_large_dist_sym[match_dist >> 8]] + s_tdefl_large_dist_extra[match_dist >> 8];
+}
+
+static MZ_FORCEINLINE void tdefl_opt_insert(tdefl_compressor *d, mz_uint pos)
+{
+  mz_uint hash = TDEFL_OPT_HASH(d->m_opt_buf + pos);
+  d->m_next[pos & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)pos;
+}
+
+// Finds the closest match of every length up to max_match_len at a position of m_opt_buf, pMatch_dist[len] is set to the
+// distance of the closest match with at least len bytes. Returns the longest length or 0 if there is no match.
+static mz_uint tdefl_opt_find_matches(tdefl_compressor *d, mz_uint pos, mz_uint max_match_len, mz_uint16 *pMatch_dist)
+{
+  const mz_uint8 *s = d->m_opt_buf + pos;
+  mz_uint best_len = TDEFL_MIN_MATCH_LEN - 1, num_probes_left = d->m_flags & TDEFL_MAX_PROBES_MASK, probe_pos = d->m_hash[TDEFL_OPT_HASH(s)];
+  while ((probe_pos) && (num_probes_left--))
+  {
+    const mz_uint8 *p = d->m_opt_buf + probe_pos;
+    mz_uint dist = pos - probe_pos, len = 0;
+    if (dist > TDEFL_LZ_DICT_SIZE) break;
+    if (p[best_len] == s[best_len])
+    {
+      while ((len < max_match_len) && (p[len] == s[len])) len++;
+      if (len > best_len)
+      {
+        do { pMatch_dist[++best_len] = (mz_uint16)dist; } while (best_len < len);
+        if (best_len == max_match_len) break;
+        // Like the other parsers, search less once a long match is found
+        if (best_len >= 32) num_probes_left = MZ_MIN(num_probes_left, (d->m_flags & TDEFL_MAX_PROBES_MASK) >> 2);
+      }
+    }
+    probe_pos = d->m_next[probe_pos & TDEFL_LZ_DICT_SIZE_MASK];
+  }
+  return (best_len >= TDEFL_MIN_MATCH_LEN) ? best_len : 0;
+}
+
+// Keeps the matches of a position for the following passes: the longest length for each distance, starting with the closest.
+// Only the last one of the lengths that do not fit is kept, shorter lengths than that use its distance from then on.
+static void tdefl_opt_cache_matches(tdefl_compressor *d, mz_uint i, mz_uint match_len, const mz_uint16 *pMatch_dist)
+{
+  mz_uint8 *pLen = d->m_opt_match_len[i]; mz_uint16 *pDist = d->m_opt_match_dist[i];
+  mz_uint len, n = 0;
+  for (len = TDEFL_MIN_MATCH_LEN; len <= match_len; len++)
+  {
+    if ((len < match_len) && (pMatch_dist[len + 1] == pMatch_dist[len])) continue;
+    if (n == TDEFL_OPT_CACHED_MATCHES) n--;
+    pLen[n] = (mz_uint8)(len - TDEFL_MIN_MATCH_LEN); pDist[n++] = pMatch_dist[len];
+  }
+  if (n < TDEFL_OPT_CACHED_MATCHES) pDist[n] = 0;
+}
+
+// Finds the cheapest path through the window for the given costs, m_opt_len[i] and m_opt_dist[i] are left with the step
+// of the path that starts at position i of the window (a length of 1 is a literal). Only the first pass searches matches.
+static void tdefl_opt_parse(tdefl_compressor *d, const tdefl_opt_costs *pCosts, mz_bool find_matches)
+{
+  mz_uint start = d->m_opt_history, size = d->m_opt_size, end = start + size, i, k, len, dist;
+  float *pCost = d->m_opt_cost; mz_uint16 *pLen = d->m_opt_len, *pDist = d->m_opt_dist;
+  mz_uint16 match_dist[TDEFL_MAX_MATCH_LEN + 1];
+
+  if (find_matches)
+  {
+    MZ_CLEAR_OBJ(d->m_hash);
+    for (i = 0; (i < start) && (i + 2 < end); i++) tdefl_opt_insert(d, i);
+  }
+
+  pCost[0] = 0.0f; for (i = 1; i <= size; i++) pCost[i] = 1e30f;
+  for (i = 0; i < size; i++)
+  {
+    mz_uint pos = start + i, max_match_len = MZ_MIN(TDEFL_MAX_MATCH_LEN, size - i), match_len = 0;
+    float cost = pCost[i], c;
+
+    if (find_matches)
+    {
+      if (max_match_len >= TDEFL_MIN_MATCH_LEN) match_len = tdefl_opt_find_matches(d, pos, max_match_len, match_dist);
+      if (pos + 2 < end) tdefl_opt_insert(d, pos);
+      tdefl_opt_cache_matches(d, i, match_len, match_dist);
+    }
+
+    c = cost + pCosts->m_lit[d->m_opt_buf[pos]];
+    if (c < pCost[i + 1]) { pCost[i + 1] = c; pLen[i + 1] = 1; pDist[i + 1] = 0; }
+
+    for (k = 0, len = TDEFL_MIN_MATCH_LEN; (k < TDEFL_OPT_CACHED_MATCHES) && ((dist = d->m_opt_match_dist[i][k]) != 0); k++)
+    {
+      mz_uint last_len = d->m_opt_match_len[i][k] + TDEFL_MIN_MATCH_LEN;
+      float dist_cost = cost + tdefl_opt_dist_cost(pCosts, dist);
+      for ( ; len <= last_len; len++)
+      {
+        c = dist_cost + pCosts->m_len[len];
+        if (c < pCost[i + len]) { pCost[i + len] = c; pLen[i + len] = (mz_uint16)len; pDist[i + len] = (mz_uint16)dist; }
+      }
+      match_len = last_len;
+    }
+
+    // Long repetitions have a maximal match at every position, these are skipped as parsing them gains next to nothing
+    if (match_len == TDEFL_MAX_MATCH_LEN)
+    {
+      if (find_matches) for (len = 1; len < TDEFL_MAX_MATCH_LEN; len++) if (pos + len + 2 < end) tdefl_opt_insert(d, pos + len);
+      i += TDEFL_MAX_MATCH_LEN - 1;
+    }
+  }
+
+  // Walk back from the end and move every step of the path from the position it reaches to the position it starts from
+  len = pLen[size]; dist = pDist[size];
+  for (i = size; i > 0; )
+  {
+    mz_uint from = i - len, next_len = pLen[from], next_dist = pDist[from];
+    pLen[from] = (mz_uint16)len; pDist[from] = (mz_uint16)dist;
+    i = from; len = next_len; dist = next_dist;
+  }
+}
+
+// Adds the symbols of the steps of a path that start in [from, to) to the statistics, returns the position after the last step.
+static mz_uint tdefl_opt_count(tdefl_compressor *d, const mz_uint16 *pLen, const mz_uint16 *pDist, mz_uint from, mz_uint to, tdefl_opt_stats *pStats)
+{
+  const mz_uint8 *pBuf = d->m_opt_buf + d->m_opt_history;
+  while (from < to)
+  {
+    mz_uint len = pLen[from], dist = pDist[from] - 1;
+    pStats->m_codes++;
+    if (len == 1)
+      pStats->m_lit[pBuf[from]]++;
+    else
+    {
+      pStats->m_matches++;
+      pStats->m_lit[s_tdefl_len_sym[len - TDEFL_MIN_MATCH_LEN]]++; pStats->m_extra_bits += s_tdefl_len_extra[len - TDEFL_MIN_MATCH_LEN];
+      if (dist < 512) { pStats->m_dist[s_tdefl_small_dist_sym[dist]]++; pStats->m_extra_bits += s_tdefl_small_dist_extra[dist]; }
+      else { pStats->m_dist[s_tdefl_large_dist_sym[dist >> 8]]++; pStats->m_extra_bits += s_tdefl_large_dist_extra[dist >> 8]; }
+    }
+    from += len;
+  }
+  return from;
+}
+
+// Estimates the size in bits of a dynamic block with the given symbols, including its header.
+static mz_uint32 tdefl_opt_block_bits(tdefl_compressor *d, const tdefl_opt_stats *pStats)
+{
+  mz_uint16 lit_count[TDEFL_MAX_HUFF_SYMBOLS_0], dist_count[TDEFL_MAX_HUFF_SYMBOLS_1];
+  mz_uint8 code_sizes[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1], packed_code_sizes[TDEFL_MAX_HUFF_SYMBOLS_0 + TDEFL_MAX_HUFF_SYMBOLS_1];
+  mz_uint8 lit_code_sizes[TDEFL_MAX_HUFF_SYMBOLS_0], dist_code_sizes[TDEFL_MAX_HUFF_SYMBOLS_1], packed_code_size_sizes[TDEFL_MAX_HUFF_SYMBOLS_2];
+  mz_uint i, num_lit_codes, num_dist_codes, num_packed_code_sizes, num_bit_lengths;
+  mz_uint32 bits = 3 + 14 + pStats->m_extra_bits;
+
+  // The counts of a block always fit the 16-bit keys of the Huffman code construction, see TDEFL_LZ_CODE_BUF_SIZE
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_0; i++) lit_count[i] = (mz_uint16)pStats->m_lit[i];
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_1; i++) dist_count[i] = (mz_uint16)pStats->m_dist[i];
+  lit_count[256] = 1;
+
+  tdefl_huffman_code_sizes(lit_count, TDEFL_MAX_HUFF_SYMBOLS_0, 15, lit_code_sizes);
+  tdefl_huffman_code_sizes(dist_count, TDEFL_MAX_HUFF_SYMBOLS_1, 15, dist_code_sizes);
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_0; i++) bits += lit_count[i] * lit_code_sizes[i];
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_1; i++) bits += dist_count[i] * dist_code_sizes[i];
+
+  for (num_lit_codes = 286; num_lit_codes > 257; num_lit_codes--) if (lit_code_sizes[num_lit_codes - 1]) break;
+  for (num_dist_codes = 30; num_dist_codes > 1; num_dist_codes--) if (dist_code_sizes[num_dist_codes - 1]) break;
+  memcpy(code_sizes, lit_code_sizes, num_lit_codes);
+  memcpy(code_sizes + num_lit_codes, dist_code_sizes, num_dist_codes);
+  num_packed_code_sizes = tdefl_pack_code_sizes(d, code_sizes, num_lit_codes + num_dist_codes, packed_code_sizes);
+  tdefl_huffman_code_sizes(d->m_huff_count[2], TDEFL_MAX_HUFF_SYMBOLS_2, 7, packed_code_size_sizes);
+
+  for (num_bit_lengths = 18; num_bit_lengths > 3; num_bit_lengths--) if (packed_code_size_sizes[s_tdefl_packed_code_size_syms_swizzle[num_bit_lengths]]) break;
+  bits += 3 * (num_bit_lengths + 1);
+  for (i = 0; i < num_packed_code_sizes; )
+  {
+    mz_uint code = packed_code_sizes[i++];
+    bits += packed_code_size_sizes[code];
+    if (code >= 16) { bits += "\02\03\07"[code - 16]; i++; }
+  }
+  return bits;
+}
+
+// Estimated size of the block with the pending codes and the steps of the best path before the given position, plus the size
+// of a block with the remaining steps up to the end. Returns the position the first block actually ends at in *pSplit.
+static mz_uint32 tdefl_opt_split_bits(tdefl_compressor *d, mz_uint pos, mz_uint end, mz_uint *pSplit)
+{
+  tdefl_opt_stats first, second; mz_uint i; mz_uint32 bits = 0;
+  MZ_CLEAR_OBJ(first); MZ_CLEAR_OBJ(second);
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_0; i++) first.m_lit[i] = d->m_huff_count[0][i];
+  for (i = 0; i < TDEFL_MAX_HUFF_SYMBOLS_1; i++) first.m_dist[i] = d->m_huff_count[1][i];
+  *pSplit = pos = tdefl_opt_count(d, d->m_opt_best_len, d->m_opt_best_dist, 0, pos, &first);
+  tdefl_opt_count(d, d->m_opt_best_len, d->m_opt_best_dist, pos, end, &second);
+  // The first block has to fit in the LZ code buffer along with the pending codes
+  if ((mz_uint)(d->m_pLZ_code_buf - d->m_lz_code_buf) + first.m_codes + 2 * first.m_matches + first.m_codes / 8 + 1 > TDEFL_LZ_CODE_BUF_SIZE - 8)
+    return 0xFFFFFFFF;
+  if ((d->m_total_lz_bytes) || (pos)) bits += tdefl_opt_block_bits(d, &first);
+  if (pos < end) bits += tdefl_opt_block_bits(d, &second);
+  return bits;
+}
+
+// Picks the end of the block with the pending codes: the end of the parsed steps, if a single block is smaller than two,
+// or otherwise the step boundary that gives the smallest pair of blocks, which is narrowed down from evenly spaced samples.
+static mz_uint tdefl_opt_split(tdefl_compressor *d, mz_uint end)
+{
+  enum { NUM_SAMPLES = 8 };
+  mz_uint lo = 0, hi = end, best_split, split, i, best_i;
+  mz_uint32 best_bits = tdefl_opt_split_bits(d, end, end, &best_split), bits;
+  if ((bits = tdefl_opt_split_bits(d, 0, end, &split)) < best_bits) { best_bits = bits; best_split = split; }
+  while (hi - lo > NUM_SAMPLES * 16)
+  {
+    mz_uint32 sample_bits = 0xFFFFFFFF;
+    for (i = 0, best_i = 0; i < NUM_SAMPLES; i++)
+    {
+      bits = tdefl_opt_split_bits(d, lo + (hi - lo) * (i + 1) / (NUM_SAMPLES + 1), end, &split);
+      if (bits < sample_bits) { sample_bits = bits; best_i = i; }
+      if (bits < best_bits) { best_bits = bits; best_split = split; }
+    }
+    i = hi - lo; hi = lo + i * (best_i + 2) / (NUM_SAMPLES + 1); lo += i * best_i / (NUM_SAMPLES + 1);
+  }
+  return best_split;
+}
+
+// Records the steps of the best path in [from, to) and copies their bytes to the dictionary that raw blocks are written from.
+static void tdefl_opt_record(tdefl_compressor *d, mz_uint from, mz_uint to)
+{
+  const mz_uint8 *pBuf = d->m_opt_buf + d->m_opt_history;
+  while (from < to)
+  {
+    mz_uint len = d->m_opt_best_len[from], i;
+    if (len == 1) tdefl_record_literal(d, pBuf[from]); else tdefl_record_match(d, len, d->m_opt_best_dist[from]);
+    for (i = 0; i < len; i++)
+    {
+      mz_uint dst_pos = (d->m_lookahead_pos + i) & TDEFL_LZ_DICT_SIZE_MASK;
+      d->m_dict[dst_pos] = pBuf[from + i]; if (dst_pos < (TDEFL_MAX_MATCH_LEN - 1)) d->m_dict[TDEFL_LZ_DICT_SIZE + dst_pos] = pBuf[from + i];
+    }
+    d->m_lookahead_pos += len; d->m_dict_size = MZ_MIN(d->m_dict_size + len, TDEFL_LZ_DICT_SIZE);
+    from += len;
+  }
+}
+
+static mz_bool tdefl_compress_optimal(tdefl_compressor *d)
+{
+  tdefl_opt_costs costs; tdefl_opt_stats stats, prev_stats;
+
+  for ( ; ; )
+  {
+    mz_uint n = (mz_uint)MZ_MIN(d->m_src_buf_left, (size_t)(TDEFL_OPT_WINDOW_SIZE - d->m_opt_size)), iteration, end, split, history;
+    mz_uint32 bits, best_bits = 0, prev_bits = 0;
+    memcpy(d->m_opt_buf + d->m_opt_history + d->m_opt_size, d->m_pSrc, n);
+    d->m_pSrc += n; d->m_src_buf_left -= n; d->m_opt_size += n;
+    // Wait for a full window unless the input is flushed
+    if ((!d->m_opt_size) || ((d->m_opt_size < TDEFL_OPT_WINDOW_SIZE) && (!d->m_flush)))
+      break;
+
+    for (iteration = 0; iteration < TDEFL_OPT_ITERATIONS; iteration++)
+    {
+      tdefl_opt_set_costs(&costs, iteration ? &prev_stats : NULL);
+      tdefl_opt_parse(d, &costs, !iteration);
+      MZ_CLEAR_OBJ(stats); tdefl_opt_count(d, d->m_opt_len, d->m_opt_dist, 0, d->m_opt_size, &stats);
+      bits = tdefl_opt_block_bits(d, &stats);
+      if ((!iteration) || (bits < best_bits))
+      {
+        best_bits = bits;
+        memcpy(d->m_opt_best_len, d->m_opt_len, sizeof(d->m_opt_len[0]) * d->m_opt_size);
+        memcpy(d->m_opt_best_dist, d->m_opt_dist, sizeof(d->m_opt_dist[0]) * d->m_opt_size);
+      }
+      // The same statistics lead to the same path again
+      else if (bits == prev_bits)
+        break;
+      prev_stats = stats; prev_bits = bits;
+    }
+
+    // Matches at the end of a window are cut short, these steps are parsed again with the next window unless the input ends
+    MZ_CLEAR_OBJ(stats); end = tdefl_opt_count(d, d->m_opt_best_len, d->m_opt_best_dist, 0, ((d->m_flush) && (!d->m_src_buf_left)) ? d->m_opt_size : d->m_opt_size - TDEFL_MAX_MATCH_LEN, &stats);
+    split = tdefl_opt_split(d, end);
+    tdefl_opt_record(d, 0, split);
+    if ((split < end) && (d->m_total_lz_bytes))
+    {
+      if (tdefl_flush_block(d, 0) < 0)
+        return MZ_FALSE;
+    }
+    tdefl_opt_record(d, split, end);
+
+    history = MZ_MIN(d->m_opt_history + end, TDEFL_LZ_DICT_SIZE);
+    memmove(d->m_opt_buf, d->m_opt_buf + d->m_opt_history + end - history, history + d->m_opt_size - end);
+    d->m_opt_history = history; d->m_opt_size -= end;
+  }
+
+  return MZ_TRUE;
+}
+
 static tdefl_status tdefl_flush_output_buffer(tdefl_compressor *d)
 {
   if (d->m_pIn_buf_size)
@@ -942,6 +1266,12 @@ tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pI
   if ((d->m_output_flush_remaining) || (d->m_finished))
     return (d->m_prev_return_status = tdefl_flush_output_buffer(d));
 
+  if (d->m_flags & TDEFL_OPTIMAL_PARSING_FLAG)
+  {
+    if (!tdefl_compress_optimal(d))
+      return d->m_prev_return_status;
+  }
+  else
 #if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
   if (((d->m_flags & TDEFL_MAX_PROBES_MASK) == 1) &&
       ((d->m_flags & TDEFL_GREEDY_PARSING_FLAG) != 0) &&
@@ -958,14 +1288,14 @@ tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pI
   }
 
   if ((d->m_flags & (TDEFL_WRITE_ZLIB_HEADER | TDEFL_COMPUTE_ADLER32)) && (pIn_buf))
-    d->m_adler32 = (mz_uint32)tdefl_adler32(d->m_adler32, (const mz_uint8 *)pIn_buf, d->m_pSrc - (const mz_uint8 *)pIn_buf);
+    d->m_adler32 = (mz_uint32)mz_adler32(d->m_adler32, (const mz_uint8 *)pIn_buf, d->m_pSrc - (const mz_uint8 *)pIn_buf);
 
   if ((flush) && (!d->m_lookahead_size) && (!d->m_src_buf_left) && (!d->m_output_flush_remaining))
   {
     if (tdefl_flush_block(d, flush) < 0)
       return d->m_prev_return_status;
     d->m_finished = (flush == TDEFL_FINISH);
-    if (flush == TDEFL_FULL_FLUSH) { MZ_CLEAR_OBJ(d->m_hash); MZ_CLEAR_OBJ(d->m_next); d->m_dict_size = 0; }
+    if (flush == TDEFL_FULL_FLUSH) { MZ_CLEAR_OBJ(d->m_hash); MZ_CLEAR_OBJ(d->m_next); d->m_dict_size = 0; d->m_opt_history = 0; }
   }
 
   return (d->m_prev_return_status = tdefl_flush_output_buffer(d));
@@ -979,6 +1309,8 @@ tdefl_status tdefl_compress_buffer(tdefl_compressor *d, const void *pIn_buf, siz
 tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags)
 {
   d->m_pPut_buf_func = pPut_buf_func; d->m_pPut_buf_user = pPut_buf_user;
+  // The optimal parser always consumes all input, which needs an output callback for the blocks it flushes on the way
+  if (!pPut_buf_func) flags &= ~TDEFL_OPTIMAL_PARSING_FLAG;
   d->m_flags = (mz_uint)(flags); d->m_max_probes[0] = 1 + ((flags & 0xFFF) + 2) / 3; d->m_greedy_parsing = (flags & TDEFL_GREEDY_PARSING_FLAG) != 0;
   d->m_max_probes[1] = 1 + (((flags & 0xFFF) >> 2) + 2) / 3;
   if (!(flags & TDEFL_NONDETERMINISTIC_PARSING_FLAG)) MZ_CLEAR_OBJ(d->m_hash);
@@ -986,7 +1318,7 @@ tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_fun
   d->m_output_flush_ofs = d->m_output_flush_remaining = d->m_finished = d->m_block_index = d->m_bit_buffer = d->m_wants_to_finish = 0;
   d->m_pLZ_code_buf = d->m_lz_code_buf + 1; d->m_pLZ_flags = d->m_lz_code_buf; d->m_num_flags_left = 8;
   d->m_pOutput_buf = d->m_output_buf; d->m_pOutput_buf_end = d->m_output_buf; d->m_prev_return_status = TDEFL_STATUS_OKAY;
-  d->m_saved_match_dist = d->m_saved_match_len = d->m_saved_lit = 0; d->m_adler32 = 1;
+  d->m_saved_match_dist = d->m_saved_match_len = d->m_saved_lit = 0; d->m_adler32 = 1; d->m_opt_history = d->m_opt_size = 0;
   d->m_pIn_buf = NULL; d->m_pOut_buf = NULL;
   d->m_pIn_buf_size = NULL; d->m_pOut_buf_size = NULL;
   d->m_flush = TDEFL_NO_FLUSH; d->m_pSrc = NULL; d->m_src_buf_left = 0; d->m_out_buf_ofs = 0;
@@ -995,6 +1327,42 @@ tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_fun
   return TDEFL_STATUS_OKAY;
 }
 
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_len)
+{
+  const mz_uint8 *pSrc = (const mz_uint8 *)pDict;
+  mz_uint i, len;
+  if ((d->m_lookahead_pos) || (d->m_lookahead_size) || (d->m_total_lz_bytes)) return TDEFL_STATUS_BAD_PARAM;
+  // Only the end of the dictionary fits in the window
+  if (dict_len > TDEFL_LZ_DICT_SIZE) { pSrc += dict_len - TDEFL_LZ_DICT_SIZE; dict_len = TDEFL_LZ_DICT_SIZE; }
+  len = (mz_uint)dict_len;
+  memcpy(d->m_dict, pSrc, len);
+  memcpy(d->m_dict + TDEFL_LZ_DICT_SIZE, pSrc, MZ_MIN(len, TDEFL_MAX_MATCH_LEN - 1));
+  if (d->m_flags & TDEFL_OPTIMAL_PARSING_FLAG) { memcpy(d->m_opt_buf, pSrc, len); d->m_opt_history = len; }
+  // Insert all positions except the last two, these are inserted by the compressor once the following bytes are known
+#if MINIZ_USE_UNALIGNED_LOADS_AND_STORES && MINIZ_LITTLE_ENDIAN
+  if (((d->m_flags & TDEFL_MAX_PROBES_MASK) == 1) &&
+      ((d->m_flags & TDEFL_GREEDY_PARSING_FLAG) != 0) &&
+      ((d->m_flags & (TDEFL_FILTER_MATCHES | TDEFL_FORCE_ALL_RAW_BLOCKS | TDEFL_RLE_MATCHES)) == 0))
+  {
+    for (i = 0; i + 2 < len; i++)
+    {
+      mz_uint trigram = pSrc[i] | (pSrc[i + 1] << 8) | (pSrc[i + 2] << 16);
+      d->m_hash[(trigram ^ (trigram >> (24 - (TDEFL_LZ_HASH_BITS - 8)))) & TDEFL_LEVEL1_HASH_SIZE_MASK] = (mz_uint16)i;
+    }
+  }
+  else
+#endif
+  {
+    for (i = 0; i + 2 < len; i++)
+    {
+      mz_uint hash = ((pSrc[i] << (TDEFL_LZ_HASH_SHIFT * 2)) ^ (pSrc[i + 1] << TDEFL_LZ_HASH_SHIFT) ^ pSrc[i + 2]) & (TDEFL_LZ_HASH_SIZE - 1);
+      d->m_next[i & TDEFL_LZ_DICT_SIZE_MASK] = d->m_hash[hash]; d->m_hash[hash] = (mz_uint16)i;
+    }
+  }
+  d->m_lookahead_pos = d->m_lz_code_buf_dict_pos = d->m_dict_size = len;
+  return TDEFL_STATUS_OKAY;
+}
+
 tdefl_status tdefl_get_prev_return_status(tdefl_compressor *d)
 {
   return d->m_prev_return_status;
@@ -30,6 +30,7 @@ extern "C" {
 // Beware: mz_ulong can be either 32 or 64-bits!
 typedef unsigned long mz_ulong;
 
+// The checksums are implemented once in inflate.c, which is linked with the compressor.
 #define MZ_ADLER32_INIT (1)
 // mz_adler32() returns the initial adler-32 value to use when called with ptr==NULL.
 mz_ulong mz_adler32(mz_ulong adler, const unsigned char *ptr, size_t buf_len);
@@ -85,6 +86,7 @@ enum
 // TDEFL_FILTER_MATCHES: Discards matches <= 5 chars if enabled.
 // TDEFL_FORCE_ALL_STATIC_BLOCKS: Disable usage of optimized Huffman tables.
 // TDEFL_FORCE_ALL_RAW_BLOCKS: Only use raw (uncompressed) deflate blocks.
+// TDEFL_OPTIMAL_PARSING_FLAG: Much slower parsing that searches the smallest sequence of literals and matches in several passes and picks the block boundaries by their estimated size. Only used with an output callback (tdefl_compress_buffer()).
 // The low 12 bits are reserved to control the max # of hash probes per dictionary lookup (see TDEFL_MAX_PROBES_MASK).
 enum
 {
@@ -95,7 +97,8 @@ enum
   TDEFL_RLE_MATCHES                   = 0x10000,
   TDEFL_FILTER_MATCHES                = 0x20000,
   TDEFL_FORCE_ALL_STATIC_BLOCKS       = 0x40000,
-  TDEFL_FORCE_ALL_RAW_BLOCKS          = 0x80000
+  TDEFL_FORCE_ALL_RAW_BLOCKS          = 0x80000,
+  TDEFL_OPTIMAL_PARSING_FLAG          = 0x100000
 };
 
 // High level compression functions:
@@ -128,6 +131,11 @@ enum { TDEFL_LZ_CODE_BUF_SIZE = 24 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_B
 enum { TDEFL_LZ_CODE_BUF_SIZE = 64 * 1024, TDEFL_OUT_BUF_SIZE = (TDEFL_LZ_CODE_BUF_SIZE * 13 ) / 10, TDEFL_MAX_HUFF_SYMBOLS = 288, TDEFL_LZ_HASH_BITS = 15, TDEFL_LEVEL1_HASH_SIZE_MASK = 4095, TDEFL_LZ_HASH_SHIFT = (TDEFL_LZ_HASH_BITS + 2) / 3, TDEFL_LZ_HASH_SIZE = 1 << TDEFL_LZ_HASH_BITS };
 #endif
 
+// Optimal parsing works on windows of TDEFL_OPT_WINDOW_SIZE bytes, each of them is parsed at most TDEFL_OPT_ITERATIONS times.
+// The matches found at a position in the first pass are kept for the others as up to TDEFL_OPT_CACHED_MATCHES pairs of the
+// longest length and the distance of the closest match with that length.
+enum { TDEFL_OPT_WINDOW_SIZE = 16384, TDEFL_OPT_ITERATIONS = 15, TDEFL_OPT_CACHED_MATCHES = 4 };
+
 // The low-level tdefl functions below may be used directly if the above helper functions aren't flexible enough. The low-level functions don't make any heap allocations, unlike the above helper functions.
 typedef enum
 {
@@ -172,6 +180,15 @@ typedef struct
   mz_uint16 m_next[TDEFL_LZ_DICT_SIZE];
   mz_uint16 m_hash[TDEFL_LZ_HASH_SIZE];
   mz_uint8 m_output_buf[TDEFL_OUT_BUF_SIZE];
+  // Optimal parsing: the window follows up to TDEFL_LZ_DICT_SIZE bytes of history in m_opt_buf, the parser keeps the cost of
+  // reaching each position of the window and the step that leads there, the cheapest path of all passes is kept separately.
+  mz_uint m_opt_history, m_opt_size;
+  mz_uint8 m_opt_buf[TDEFL_LZ_DICT_SIZE + TDEFL_OPT_WINDOW_SIZE];
+  mz_uint8 m_opt_match_len[TDEFL_OPT_WINDOW_SIZE][TDEFL_OPT_CACHED_MATCHES];
+  mz_uint16 m_opt_match_dist[TDEFL_OPT_WINDOW_SIZE][TDEFL_OPT_CACHED_MATCHES];
+  float m_opt_cost[TDEFL_OPT_WINDOW_SIZE + 1];
+  mz_uint16 m_opt_len[TDEFL_OPT_WINDOW_SIZE + 1], m_opt_dist[TDEFL_OPT_WINDOW_SIZE + 1];
+  mz_uint16 m_opt_best_len[TDEFL_OPT_WINDOW_SIZE + 1], m_opt_best_dist[TDEFL_OPT_WINDOW_SIZE + 1];
 } tdefl_compressor;
 
 // Initializes the compressor.
@@ -181,6 +198,11 @@ typedef struct
 // flags: See the above enums (TDEFL_HUFFMAN_ONLY, TDEFL_WRITE_ZLIB_HEADER, etc.)
 tdefl_status tdefl_init(tdefl_compressor *d, tdefl_put_buf_func_ptr pPut_buf_func, void *pPut_buf_user, int flags);
 
+// Loads a preset dictionary into the compressor, must be called after tdefl_init() and before any data is compressed.
+// Matches can refer to the last TDEFL_LZ_DICT_SIZE bytes of the dictionary, the decompressor has to start with the same
+// bytes in its dictionary. Nothing is output for the dictionary itself.
+tdefl_status tdefl_set_dictionary(tdefl_compressor *d, const void *pDict, size_t dict_len);
+
 // Compresses a block of data, consuming as much of the specified input buffer as possible, and writing as much compressed data to the specified output buffer as possible.
 tdefl_status tdefl_compress(tdefl_compressor *d, const void *pIn_buf, size_t *pIn_buf_size, void *pOut_buf, size_t *pOut_buf_size, tdefl_flush flush);
 
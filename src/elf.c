@@ -0,0 +1,254 @@
+
+#include <string.h>
+#include "elf.h"
+
+#define ELF_HEADER_SIZE 64
+#define ELF_SECTION_HEADER_SIZE 64
+#define ELF_SYMBOL_SIZE 24
+#define ELF_RELA_SIZE 24
+
+#define ELF_SHT_PROGBITS 1
+#define ELF_SHT_SYMTAB 2
+#define ELF_SHT_STRTAB 3
+#define ELF_SHT_RELA 4
+
+#define ELF_SHF_WRITE 0x1
+#define ELF_SHF_ALLOC 0x2
+#define ELF_SHF_INFO_LINK 0x40
+
+#define ELF_STB_LOCAL 0
+#define ELF_STB_GLOBAL 1
+#define ELF_STT_OBJECT 1
+#define ELF_STT_SECTION 3
+
+#define ELF_R_X86_64_64 1
+#define ELF_R_AARCH64_ABS64 257
+
+// Section indices in the order they are written, ELF_SECTION_RODATA and ELF_SECTION_RELRO come first
+enum { ELF_SECTION_RELA = 3, ELF_SECTION_SYMTAB, ELF_SECTION_STRTAB, ELF_SECTION_SHSTRTAB, ELF_SECTION_NOTE, ELF_SECTION_COUNT };
+
+static const char elf_section_names[] = "\0.rodata\0.data.rel.ro\0.rela.data.rel.ro\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+enum { ELF_NAME_RODATA = 1, ELF_NAME_RELRO = 9, ELF_NAME_RELA = 22, ELF_NAME_SYMTAB = 40, ELF_NAME_STRTAB = 48, ELF_NAME_SHSTRTAB = 56, ELF_NAME_NOTE = 66 };
+
+static void elf_buffer_write(elf_buffer* buffer, const void* data, size_t len)
+{
+    if (buffer->length + len > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 1024;
+        while (capacity < buffer->length + len)
+            capacity *= 2;
+        buffer->data = (unsigned char*) realloc(buffer->data, capacity);
+        buffer->capacity = capacity;
+    }
+
+    memcpy(&(buffer->data[buffer->length]), data, len);
+    buffer->length += len;
+}
+
+static void elf_buffer_integer(elf_buffer* buffer, elf_uint64 value, int size)
+{
+    unsigned char bytes[8];
+    int i;
+    for (i = 0; i < size; i++)
+        bytes[i] = (unsigned char) ((value >> (8 * i)) & 0xFF);
+    elf_buffer_write(buffer, bytes, size);
+}
+
+static void elf_buffer_free(elf_buffer* buffer)
+{
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+static void elf_write_integer(FILE* out, elf_uint64 value, int size)
+{
+    unsigned char bytes[8];
+    int i;
+    for (i = 0; i < size; i++)
+        bytes[i] = (unsigned char) ((value >> (8 * i)) & 0xFF);
+    fwrite(bytes, 1, size, out);
+}
+
+static void elf_write_padding(FILE* out, elf_uint64 position, size_t alignment)
+{
+    while (position % alignment)
+    {
+        fputc(0, out);
+        position++;
+    }
+}
+
+static void elf_write_section_header(FILE* out, int name, int type, elf_uint64 flags, elf_uint64 offset, elf_uint64 size,
+    int link, int info, elf_uint64 alignment, elf_uint64 entry_size)
+{
+    elf_write_integer(out, name, 4);
+    elf_write_integer(out, type, 4);
+    elf_write_integer(out, flags, 8);
+    elf_write_integer(out, 0, 8);
+    elf_write_integer(out, offset, 8);
+    elf_write_integer(out, size, 8);
+    elf_write_integer(out, link, 4);
+    elf_write_integer(out, info, 4);
+    elf_write_integer(out, alignment, 8);
+    elf_write_integer(out, entry_size, 8);
+}
+
+static void elf_add_symbol(elf_writer* elf, int name, int info, int section, elf_uint64 offset, elf_uint64 size)
+{
+    elf_buffer_integer(&elf->symbols, name, 4);
+    elf_buffer_integer(&elf->symbols, info, 1);
+    elf_buffer_integer(&elf->symbols, 0, 1);
+    elf_buffer_integer(&elf->symbols, section, 2);
+    elf_buffer_integer(&elf->symbols, offset, 8);
+    elf_buffer_integer(&elf->symbols, size, 8);
+}
+
+static void elf_write_header(elf_writer* elf, elf_uint64 section_headers)
+{
+    static const unsigned char ident[16] = {0x7F, 'E', 'L', 'F', 2, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    fwrite(ident, 1, sizeof(ident), elf->out);
+    elf_write_integer(elf->out, 1, 2); // Relocatable file
+    elf_write_integer(elf->out, elf->machine, 2);
+    elf_write_integer(elf->out, 1, 4);
+    elf_write_integer(elf->out, 0, 8);
+    elf_write_integer(elf->out, 0, 8);
+    elf_write_integer(elf->out, section_headers, 8);
+    elf_write_integer(elf->out, 0, 4);
+    elf_write_integer(elf->out, ELF_HEADER_SIZE, 2);
+    elf_write_integer(elf->out, 0, 2);
+    elf_write_integer(elf->out, 0, 2);
+    elf_write_integer(elf->out, ELF_SECTION_HEADER_SIZE, 2);
+    elf_write_integer(elf->out, section_headers ? ELF_SECTION_COUNT : 0, 2);
+    elf_write_integer(elf->out, section_headers ? ELF_SECTION_SHSTRTAB : 0, 2);
+}
+
+int elf_begin(elf_writer* elf, FILE* out, int machine)
+{
+    if (machine != ELF_MACHINE_X86_64 && machine != ELF_MACHINE_AARCH64)
+        return 0;
+
+    memset(elf, 0, sizeof(elf_writer));
+    elf->out = out;
+    elf->machine = machine;
+
+    // The header is written again once the position of section headers is known
+    elf_write_header(elf, 0);
+
+    elf_buffer_integer(&elf->strings, 0, 1);
+    elf_add_symbol(elf, 0, 0, 0, 0, 0);
+    elf_add_symbol(elf, 0, (ELF_STB_LOCAL << 4) | ELF_STT_SECTION, ELF_SECTION_RODATA, 0, 0);
+    elf_add_symbol(elf, 0, (ELF_STB_LOCAL << 4) | ELF_STT_SECTION, ELF_SECTION_RELRO, 0, 0);
+
+    return 1;
+}
+
+elf_uint64 elf_rodata_offset(elf_writer* elf)
+{
+    return (elf_uint64) ftell(elf->out) - ELF_HEADER_SIZE;
+}
+
+elf_uint64 elf_rodata_write(elf_writer* elf, const void* data, size_t len)
+{
+    elf_uint64 offset = elf_rodata_offset(elf);
+    fwrite(data, 1, len, elf->out);
+    return offset;
+}
+
+elf_uint64 elf_rodata_integer(elf_writer* elf, elf_uint64 value, int size)
+{
+    elf_uint64 offset = elf_rodata_offset(elf);
+    elf_write_integer(elf->out, value, size);
+    return offset;
+}
+
+elf_uint64 elf_rodata_align(elf_writer* elf, size_t alignment)
+{
+    elf_write_padding(elf->out, elf_rodata_offset(elf), alignment);
+    return elf_rodata_offset(elf);
+}
+
+elf_uint64 elf_relro_pointer(elf_writer* elf, int section, elf_uint64 offset)
+{
+    elf_uint64 position = elf->relro.length;
+    int type = (elf->machine == ELF_MACHINE_X86_64) ? ELF_R_X86_64_64 : ELF_R_AARCH64_ABS64;
+
+    // The section symbols are the first two symbols after the null one
+    elf_buffer_integer(&elf->relocations, position, 8);
+    elf_buffer_integer(&elf->relocations, ((elf_uint64) section << 32) | type, 8);
+    elf_buffer_integer(&elf->relocations, offset, 8);
+
+    elf_buffer_integer(&elf->relro, 0, 8);
+    return position;
+}
+
+elf_uint64 elf_relro_null(elf_writer* elf)
+{
+    elf_uint64 position = elf->relro.length;
+    elf_buffer_integer(&elf->relro, 0, 8);
+    return position;
+}
+
+elf_uint64 elf_relro_offset(elf_writer* elf)
+{
+    return elf->relro.length;
+}
+
+void elf_symbol(elf_writer* elf, const char* name, int section, elf_uint64 offset, elf_uint64 size)
+{
+    int position = (int) elf->strings.length;
+    elf_buffer_write(&elf->strings, name, strlen(name) + 1);
+    elf_add_symbol(elf, position, (ELF_STB_GLOBAL << 4) | ELF_STT_OBJECT, section, offset, size);
+}
+
+int elf_end(elf_writer* elf)
+{
+    elf_uint64 rodata_size = elf_rodata_offset(elf);
+    elf_uint64 relro, rela, symtab, strtab, shstrtab, headers;
+    FILE* out = elf->out;
+
+    elf_write_padding(out, ELF_HEADER_SIZE + rodata_size, 8);
+    relro = ELF_HEADER_SIZE + rodata_size + (8 - rodata_size % 8) % 8;
+    fwrite(elf->relro.data, 1, elf->relro.length, out);
+
+    rela = relro + elf->relro.length;
+    fwrite(elf->relocations.data, 1, elf->relocations.length, out);
+
+    symtab = rela + elf->relocations.length;
+    fwrite(elf->symbols.data, 1, elf->symbols.length, out);
+
+    strtab = symtab + elf->symbols.length;
+    fwrite(elf->strings.data, 1, elf->strings.length, out);
+
+    shstrtab = strtab + elf->strings.length;
+    fwrite(elf_section_names, 1, sizeof(elf_section_names), out);
+
+    elf_write_padding(out, shstrtab + sizeof(elf_section_names), 8);
+    headers = shstrtab + sizeof(elf_section_names);
+    headers += (8 - headers % 8) % 8;
+
+    elf_write_section_header(out, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    elf_write_section_header(out, ELF_NAME_RODATA, ELF_SHT_PROGBITS, ELF_SHF_ALLOC, ELF_HEADER_SIZE, rodata_size, 0, 0, 8, 0);
+    elf_write_section_header(out, ELF_NAME_RELRO, ELF_SHT_PROGBITS, ELF_SHF_ALLOC | ELF_SHF_WRITE, relro, elf->relro.length, 0, 0, 8, 0);
+    elf_write_section_header(out, ELF_NAME_RELA, ELF_SHT_RELA, ELF_SHF_INFO_LINK, rela, elf->relocations.length, ELF_SECTION_SYMTAB, ELF_SECTION_RELRO, 8, ELF_RELA_SIZE);
+    // All symbols except the null one and the two section symbols are global
+    elf_write_section_header(out, ELF_NAME_SYMTAB, ELF_SHT_SYMTAB, 0, symtab, elf->symbols.length, ELF_SECTION_STRTAB, 3, 8, ELF_SYMBOL_SIZE);
+    elf_write_section_header(out, ELF_NAME_STRTAB, ELF_SHT_STRTAB, 0, strtab, elf->strings.length, 0, 0, 1, 0);
+    elf_write_section_header(out, ELF_NAME_SHSTRTAB, ELF_SHT_STRTAB, 0, shstrtab, sizeof(elf_section_names), 0, 0, 1, 0);
+    elf_write_section_header(out, ELF_NAME_NOTE, ELF_SHT_PROGBITS, 0, headers, 0, 0, 0, 1, 0);
+
+    elf_buffer_free(&elf->relro);
+    elf_buffer_free(&elf->relocations);
+    elf_buffer_free(&elf->symbols);
+    elf_buffer_free(&elf->strings);
+
+    if (fseek(out, 0, SEEK_SET) != 0)
+        return 0;
+
+    elf_write_header(elf, headers);
+    fflush(out);
+
+    return !ferror(out);
+}
@@ -0,0 +1,78 @@
+#ifndef _ELF_H
+#define _ELF_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Minimal writer for 64-bit little-endian relocatable ELF objects that only contain data.
+// Pointer-free data goes to .rodata and is streamed directly to the output file, tables of
+// pointers are collected in .data.rel.ro and written together with their relocations at the end.
+
+typedef unsigned long long elf_uint64;
+
+#define ELF_MACHINE_X86_64 62
+#define ELF_MACHINE_AARCH64 183
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define ELF_MACHINE_HOST ELF_MACHINE_X86_64
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ELF_MACHINE_HOST ELF_MACHINE_AARCH64
+#else
+#define ELF_MACHINE_HOST 0
+#endif
+
+// Sections that symbols and pointers can refer to.
+#define ELF_SECTION_RODATA 1
+#define ELF_SECTION_RELRO 2
+
+typedef struct elf_buffer {
+    unsigned char* data;
+    size_t length;
+    size_t capacity;
+} elf_buffer;
+
+typedef struct elf_writer {
+    FILE* out;
+    int machine;
+    elf_buffer relro;
+    elf_buffer relocations;
+    elf_buffer symbols;
+    elf_buffer strings;
+} elf_writer;
+
+// Starts a new object in a seekable output file. Returns 0 if the machine is not supported.
+int elf_begin(elf_writer* elf, FILE* out, int machine);
+
+// Current size of .rodata, i.e. the offset of the next byte written to it. Data can also be
+// written to .rodata by writing to the output file directly (until elf_end is called).
+elf_uint64 elf_rodata_offset(elf_writer* elf);
+
+elf_uint64 elf_rodata_write(elf_writer* elf, const void* data, size_t len);
+
+// Writes a little-endian integer of the given size (1, 2, 4 or 8 bytes) to .rodata.
+elf_uint64 elf_rodata_integer(elf_writer* elf, elf_uint64 value, int size);
+
+elf_uint64 elf_rodata_align(elf_writer* elf, size_t alignment);
+
+// Appends a pointer to the given offset of a section to .data.rel.ro and returns its offset.
+elf_uint64 elf_relro_pointer(elf_writer* elf, int section, elf_uint64 offset);
+
+elf_uint64 elf_relro_null(elf_writer* elf);
+
+elf_uint64 elf_relro_offset(elf_writer* elf);
+
+// Adds a global data symbol.
+void elf_symbol(elf_writer* elf, const char* name, int section, elf_uint64 offset, elf_uint64 size);
+
+// Writes the remaining sections and the headers, the output file is not closed.
+int elf_end(elf_writer* elf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,149 @@
+
+#include <string.h>
+#include "lz.h"
+
+static unsigned int lz_hash(const unsigned char* data)
+{
+    unsigned int value = (unsigned int) data[0] | ((unsigned int) data[1] << 8) | ((unsigned int) data[2] << 16) | ((unsigned int) data[3] << 24);
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void lz_insert(lz_compressor* lz, const unsigned char* data, size_t pos)
+{
+    unsigned int hash = lz_hash(&data[pos]);
+    lz->chain[pos] = lz->head[hash];
+    lz->head[hash] = (int) pos;
+}
+
+// Finds the longest match for the given position that ends before the limit, returns 0 if there is none
+static size_t lz_find(lz_compressor* lz, const unsigned char* data, size_t pos, size_t limit, size_t* offset)
+{
+    int candidate = lz->head[lz_hash(&data[pos])];
+    int probes = lz->probes;
+    size_t best = LZ_MIN_MATCH - 1;
+
+    while (candidate >= 0 && probes-- > 0)
+    {
+        const unsigned char* match = &data[candidate];
+
+        // A longer match has to differ from the best one at its last byte
+        if (match[best] == data[pos + best] && memcmp(match, &data[pos], LZ_MIN_MATCH) == 0)
+        {
+            size_t length = LZ_MIN_MATCH;
+
+            while (pos + length < limit && match[length] == data[pos + length])
+                length++;
+
+            if (length > best)
+            {
+                best = length;
+                *offset = pos - (size_t) candidate;
+
+                if (pos + length == limit)
+                    break;
+            }
+        }
+
+        candidate = lz->chain[candidate];
+    }
+
+    return (best >= LZ_MIN_MATCH) ? best : 0;
+}
+
+static unsigned char* lz_length(unsigned char* out, size_t length)
+{
+    while (length >= 255)
+    {
+        *(out++) = 255;
+        length -= 255;
+    }
+
+    *(out++) = (unsigned char) length;
+    return out;
+}
+
+// Writes the literals followed by a match, the last sequence of a chunk has no match
+static unsigned char* lz_sequence(unsigned char* out, const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length)
+{
+    unsigned char* token = out++;
+    size_t extra = match_length ? match_length - LZ_MIN_MATCH : 0;
+
+    *token = (unsigned char) (((literal_length < 15) ? literal_length : 15) << 4);
+    if (literal_length >= 15)
+        out = lz_length(out, literal_length - 15);
+
+    memcpy(out, literals, literal_length);
+    out += literal_length;
+
+    if (!match_length)
+        return out;
+
+    *(out++) = (unsigned char) (offset & 0xFF);
+    *(out++) = (unsigned char) (offset >> 8);
+
+    *token |= (unsigned char) ((extra < 15) ? extra : 15);
+    if (extra >= 15)
+        out = lz_length(out, extra - 15);
+
+    return out;
+}
+
+void lz_init(lz_compressor* lz, int probes, int lazy)
+{
+    lz->probes = (probes > 0) ? probes : 1;
+    lz->lazy = lazy;
+}
+
+size_t lz_compress_chunk(lz_compressor* lz, const unsigned char* data, size_t len, unsigned char* out)
+{
+    unsigned char* dst = out;
+    size_t pos = 0, anchor = 0;
+
+    memset(lz->head, 0xFF, sizeof(lz->head));
+
+    if (len > LZ_MATCH_LIMIT)
+    {
+        size_t last = len - LZ_MATCH_LIMIT;
+        size_t limit = len - LZ_LAST_LITERALS;
+
+        while (pos < last)
+        {
+            size_t offset = 0, end;
+            size_t length = lz_find(lz, data, pos, limit, &offset);
+
+            lz_insert(lz, data, pos);
+
+            if (!length)
+            {
+                pos++;
+                continue;
+            }
+
+            // Lazy parsing emits a literal instead if the next position has a longer match
+            while (lz->lazy && pos + 1 < last)
+            {
+                size_t next_offset = 0;
+                size_t next_length = lz_find(lz, data, pos + 1, limit, &next_offset);
+
+                if (next_length <= length)
+                    break;
+
+                lz_insert(lz, data, ++pos);
+                length = next_length;
+                offset = next_offset;
+            }
+
+            dst = lz_sequence(dst, &data[anchor], pos - anchor, offset, length);
+
+            end = pos + length;
+            for (pos++; pos < end && pos < last; pos++)
+                lz_insert(lz, data, pos);
+
+            pos = end;
+            anchor = pos;
+        }
+    }
+
+    dst = lz_sequence(dst, &data[anchor], len - anchor, 0, 0);
+    return (size_t) (dst - out);
+}
@@ -0,0 +1,42 @@
+#ifndef _LZ_H
+#define _LZ_H
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Compressor of the fast codec, an LZ77 format without an entropy stage that uses the sequences of LZ4 blocks:
+// a token with the number of literals and the match length, the literals, a 16-bit offset and the rest of the
+// match length. Data is compressed in chunks that do not refer to each other and are decompressed with a known
+// length, the last 5 bytes of a chunk are always literals and the last match starts at least 12 bytes before its end.
+
+#define LZ_CHUNK_SIZE (32*1024)
+#define LZ_HASH_BITS 15
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MATCH_LIMIT 12
+
+// Maximal compressed length of a chunk
+#define LZ_BOUND(L) ((L) + (L) / 255 + 16)
+
+typedef struct lz_compressor {
+    int head[1 << LZ_HASH_BITS];
+    int chain[LZ_CHUNK_SIZE];
+    int probes;
+    int lazy;
+} lz_compressor;
+
+// Sets the number of earlier positions that are compared to find a match and if a match is given up
+// for a longer one at the next position.
+void lz_init(lz_compressor* lz, int probes, int lazy);
+
+// Compresses a chunk of at most LZ_CHUNK_SIZE bytes to an output of at least LZ_BOUND(len) bytes, returns the compressed length.
+size_t lz_compress_chunk(lz_compressor* lz, const unsigned char* data, size_t len, unsigned char* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
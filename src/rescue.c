@@ -4,6 +4,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "deflate.h"
+#include "elf.h"
+#include "lz.h"
+#include "sha256.h"
 
 #ifndef RESCUE_BOOTSTRAP
 #define rescue_header_only
@@ -16,19 +19,116 @@
 #define LINE_WIDTH 80
 #define STRING_LENGTH (1024)
 #define MAX_PATH 2048
+#define OUTPUT_BUFFER_SIZE (1024*1024)
+#define INPUT_BUFFER_SIZE (4*1024*1024)
+#define RESOURCE_FAILED ((size_t) -1) // Sizes of a resource whose file could not be read
+#define WORKER_WINDOW 4 // Jobs per worker that may be compressed ahead of the one that is written
+
+#define FORMAT_C 0
+#define FORMAT_ELF 1
+
+#define ENCODING_STRING 0
+#define ENCODING_MINIMAL 1
+#define ENCODING_HEX 2
+#define ENCODING_DECIMAL 3
+#define ENCODING_EMBED 4
+#define ENCODING_RAW 5
+
+#define STRATEGY_DEFAULT 0
+#define STRATEGY_FILTERED 1
+#define STRATEGY_HUFFMAN 2
+#define STRATEGY_RLE 3
+#define STRATEGY_FIXED 4
+#define STRATEGY_OPTIMAL 5
+
+#define CODEC_DEFLATE 0
+#define CODEC_LZ 1
+
+#define DEFAULT_LEVEL 10
+#define COMPRESSION_STORE (-1)
+#define COMPRESSION_LZ 0x1000000 // Compressor flag of the fast codec, it uses the probes and parsing flags of deflate
+#define SAMPLE_SIZE (64*1024)
+#define META_COMPRESSION 1
+#define META_DICTIONARY 2
+#define META_BLOCKS 4
+#define META_CONTIGUOUS 8
+#define META_LZ 16
+
+#define MAX_DICTIONARY_SIZE (32*1024)
+#define TRAINING_FILE_LIMIT (64*1024)
+#define TRAINING_DATA_LIMIT (32*1024*1024)
+#define TRAINING_SEGMENT 64
+#define TRAINING_DMER 8
+#define TRAINING_HASH_BITS 20
+#define DEFAULT_STORE_THRESHOLD 5
+#define MIN_BLOCK_SIZE (4*1024)
+#define CACHE_VERSION 3
+#define CACHE_KEY_LENGTH (SHA256_DIGEST_SIZE * 2)
 
 #if defined(__OS2__) || defined(__WINDOWS__) || defined(WIN32) || defined(WIN64) || defined(_MSC_VER)
 #include <windows.h>
+#define RESCUE_WINDOWS 1
 #define PATH_DELIMITER '\\'
 #define IS_PATH_DELIMITER(C) ((C) == '\\' || (C) == '/')
 #define PWD(B, L) GetCurrentDirectory(L, B)
 #define ABSOLUTE_PATH(R, A, L) GetFullPathName(R, L, A, NULL)
+#define ABSOLUTE_PATH_LENGTH MAX_PATH
+#include <direct.h>
+#define MAKE_DIRECTORY(P) _mkdir(P)
+int is_directory(const char* path) { DWORD a = GetFileAttributes(path); return a != INVALID_FILE_ATTRIBUTES && (a & FILE_ATTRIBUTE_DIRECTORY); }
+long file_length(const char* path) { WIN32_FILE_ATTRIBUTE_DATA d; return GetFileAttributesEx(path, GetFileExInfoStandard, &d) && d.nFileSizeHigh == 0 && d.nFileSizeLow <= 0x7fffffff ? (long) d.nFileSizeLow : -1; }
+#define PROCESS_ID() ((int) GetCurrentProcessId())
+typedef HANDLE thread_t;
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE condition_t;
+#define THREAD_FUNCTION(N, A) DWORD WINAPI N(LPVOID A)
+#define THREAD_RETURN return 0
+#define THREAD_CREATE(T, F, A) (((T) = CreateThread(NULL, 0, F, A, 0, NULL)) != NULL)
+#define THREAD_JOIN(T) {WaitForSingleObject(T, INFINITE); CloseHandle(T);}
+#define MUTEX_INIT(M) InitializeCriticalSection(&(M))
+#define MUTEX_DESTROY(M) DeleteCriticalSection(&(M))
+#define MUTEX_LOCK(M) EnterCriticalSection(&(M))
+#define MUTEX_UNLOCK(M) LeaveCriticalSection(&(M))
+#define CONDITION_INIT(C) InitializeConditionVariable(&(C))
+#define CONDITION_DESTROY(C)
+#define CONDITION_WAIT(C, M) SleepConditionVariableCS(&(C), &(M), INFINITE)
+#define CONDITION_BROADCAST(C) WakeAllConditionVariable(&(C))
+double timestamp() { LARGE_INTEGER t, f; QueryPerformanceCounter(&t); QueryPerformanceFrequency(&f); return (double) t.QuadPart / (double) f.QuadPart; }
 #else
 #include <unistd.h>
 #define PATH_DELIMITER '/'
 #define IS_PATH_DELIMITER(C) ((C) == '/')
 #define PWD(B, L) getcwd(B, L)
 #define ABSOLUTE_PATH(R, A, L) realpath(R, A)
+#include <limits.h>
+#ifndef PATH_MAX
+#define PATH_MAX 4096
+#endif
+#define ABSOLUTE_PATH_LENGTH PATH_MAX // realpath writes up to PATH_MAX bytes regardless of the buffer
+#include <sys/stat.h>
+#define MAKE_DIRECTORY(P) mkdir(P, 0777)
+#include <dirent.h>
+int is_directory(const char* path) { struct stat s; return stat(path, &s) == 0 && S_ISDIR(s.st_mode); }
+long file_length(const char* path) { struct stat s; return stat(path, &s) == 0 && S_ISREG(s.st_mode) ? (long) s.st_size : -1; }
+#define PROCESS_ID() ((int) getpid())
+#include <pthread.h>
+typedef pthread_t thread_t;
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t condition_t;
+#define THREAD_FUNCTION(N, A) void* N(void* A)
+#define THREAD_RETURN return NULL
+#define THREAD_CREATE(T, F, A) (pthread_create(&(T), NULL, F, A) == 0)
+#define THREAD_JOIN(T) pthread_join(T, NULL)
+#define MUTEX_INIT(M) pthread_mutex_init(&(M), NULL)
+#define MUTEX_DESTROY(M) pthread_mutex_destroy(&(M))
+#define MUTEX_LOCK(M) pthread_mutex_lock(&(M))
+#define MUTEX_UNLOCK(M) pthread_mutex_unlock(&(M))
+#define CONDITION_INIT(C) pthread_cond_init(&(C), NULL)
+#define CONDITION_DESTROY(C) pthread_cond_destroy(&(C))
+#define CONDITION_WAIT(C, M) pthread_cond_wait(&(C), &(M))
+#define CONDITION_BROADCAST(C) pthread_cond_broadcast(&(C))
+#include <time.h>
+double timestamp() { struct timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + t.tv_nsec * 1e-9; }
 #endif
 
 #ifdef RESCUE_BOOTSTRAP
@@ -37,11 +137,36 @@
 
 #define PING {fprintf(stderr, "%s(%d): PING\n", __FILE__, __LINE__); }
 
+typedef struct output_buffer {
+    FILE* sink;
+    char* data;
+    size_t length;
+    size_t capacity;
+} output_buffer;
+
+typedef struct encoding_table {
+    char symbol[256][8];
+    int length[256];
+    int octal[256]; // Symbol ends with an octal escape that a following digit would extend
+} encoding_table;
+
+typedef struct compression_settings {
+    int encoding;
+    int threshold; // Minimal size reduction in percent, otherwise the data is stored uncompressed
+    const char* dictionary; // Preset dictionary for all compressed resources or NULL
+    size_t dictionary_length;
+    size_t block_size; // Larger resources are compressed in independently decodable blocks, 0 if disabled
+    int contiguous; // Stored resources are written as byte arrays instead of string segments
+} compression_settings;
+
 typedef struct compression_data {
-    FILE* out;
+    output_buffer* out;
+    const encoding_table* table;
     int line;
     int segment;
     int total;
+    int previous;
+    int octal;
 } compression_data;
 
 typedef struct source_data {
@@ -55,14 +180,151 @@ typedef struct resource_data {
     size_t inflated;
     size_t deflated;
     int metadata;
+    unsigned int crc; // CRC-32 of the uncompressed data
+    size_t* blocks; // Offsets of the blocks in the compressed data if the resource is compressed in blocks
+    int block_count;
 } resource_data;
 
+typedef struct resource_job {
+    char* filename;
+    char* name;
+    output_buffer data;
+    resource_data result;
+    int flags;
+    long size; // Size of the file if known from the directory listing or -1
+    int duplicate; // Index of an earlier job with the same content and flags or -1
+    int index; // Index of the resource in the generated tables
+    int cached;
+    int done;
+} resource_job;
+
+typedef struct worker_pool {
+    resource_job* jobs;
+    const compression_settings* settings;
+    const char* cache;
+    int count;
+    int next;
+    int written; // Jobs before this one have been written and their data released
+    int window; // Number of jobs that may be compressed ahead of the writer
+    mutex_t mutex;
+    condition_t finished;
+    condition_t progress;
+} worker_pool;
+
 typedef int (*data_callback)(const void* buffer, int len, void *user);
 
+// Representations of every byte in the generated source, filled by encoding_init()
+static encoding_table string_table;
+static encoding_table minimal_table;
+static encoding_table hex_table;
+static encoding_table decimal_table;
+
+void encoding_init()
+{
+    int c;
+    for (c = 0; c < 256; c++)
+    {
+        // String literal with every special character as a three digit octal escape
+        if (c < 32 || c == '"' || c == '\\' || c > 126) {
+            sprintf(string_table.symbol[c], "\\%03o", c);
+        } else {
+            sprintf(string_table.symbol[c], "%c", c);
+        }
+        string_table.length[c] = strlen(string_table.symbol[c]);
+        string_table.octal[c] = 0;
+
+        // String literal with the shortest escape for every character
+        minimal_table.octal[c] = 0;
+        if (c == '"' || c == '\\') {
+            sprintf(minimal_table.symbol[c], "\\%c", c);
+        } else if (c == '\t' || (c >= 32 && c <= 126)) {
+            sprintf(minimal_table.symbol[c], "%c", c);
+        } else if (c >= '\a' && c <= '\r') {
+            sprintf(minimal_table.symbol[c], "\\%c", "abtnvfr"[c - '\a']);
+        } else {
+            sprintf(minimal_table.symbol[c], "\\%o", c);
+            minimal_table.octal[c] = c < 64;
+        }
+        minimal_table.length[c] = strlen(minimal_table.symbol[c]);
+
+        sprintf(hex_table.symbol[c], "0x%02x,", c);
+        hex_table.length[c] = strlen(hex_table.symbol[c]);
+        hex_table.octal[c] = 0;
+
+        sprintf(decimal_table.symbol[c], "%d,", c);
+        decimal_table.length[c] = strlen(decimal_table.symbol[c]);
+        decimal_table.octal[c] = 0;
+    }
+}
+
+// Stops when memory for jobs or their data runs out, the partial output would be useless
+void* checked_allocation(void* pointer)
+{
+    if (!pointer)
+    {
+        fprintf(stderr, "Out of memory.\n");
+        exit(-1);
+    }
+
+    return pointer;
+}
+
+// If the buffer has a sink it is flushed to it when full, otherwise it grows to hold all the data
+void buffer_init(output_buffer* buffer, FILE* sink)
+{
+    buffer->sink = sink;
+    buffer->length = 0;
+    buffer->capacity = sink ? OUTPUT_BUFFER_SIZE : 0;
+    buffer->data = sink ? (char*) checked_allocation(malloc(buffer->capacity)) : NULL;
+}
+
+void buffer_flush(output_buffer* buffer)
+{
+    if (buffer->sink && buffer->length > 0)
+    {
+        fwrite(buffer->data, sizeof(char), buffer->length, buffer->sink);
+        buffer->length = 0;
+    }
+}
+
+void buffer_free(output_buffer* buffer)
+{
+    buffer_flush(buffer);
+    free(buffer->data);
+    buffer->data = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+// Makes room for at least len more bytes at the end of the buffer
+void buffer_reserve(output_buffer* buffer, size_t len)
+{
+    if (buffer->length + len <= buffer->capacity)
+        return;
+
+    buffer_flush(buffer);
+
+    if (buffer->length + len > buffer->capacity)
+    {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (capacity < buffer->length + len)
+            capacity *= 2;
+        buffer->data = (char*) checked_allocation(realloc(buffer->data, capacity));
+        buffer->capacity = capacity;
+    }
+}
+
+void buffer_write(output_buffer* buffer, const char* data, size_t len)
+{
+    buffer_reserve(buffer, len);
+    memcpy(&(buffer->data[buffer->length]), data, len);
+    buffer->length += len;
+}
+
 int path_join(const char* root, const char* path, char** out) {
 
     size_t rlen = strlen(root);
-    size_t plen = strlen(root);
+    size_t plen = strlen(path);
 
     *out = (char*) malloc(sizeof(char) * (rlen + plen + 2));
 
@@ -113,365 +375,2786 @@ int path_split(const char* path, char** parent, char** name) {
 
 mz_bool compression_callback(const void* data, int len, void *user)
 {
-    int i;
-    const char* buffer = (const char*) data;
+    const unsigned char* buffer = (const unsigned char*) data;
     compression_data* env = (compression_data*) user;
-    int l = env->total;
+    const encoding_table* table = env->table;
+    int i = 0;
 
-    for (i = 0; i < len; i++)
+    // Every iteration outputs at most one line, ending it early at the end of a segment
+    while (i < len)
     {
-        if (env->line == 0)
+        char* dst;
+        int line = env->line;
+        int segment = STRING_LENGTH - (env->total % STRING_LENGTH);
+        int end = (len - i < segment) ? len : i + segment;
+
+        buffer_reserve(env->out, LINE_WIDTH + 16);
+        dst = &(env->out->data[env->out->length]);
+
+        if (line == 0)
         {
-            fprintf(env->out, "\n\"");
+            *(dst++) = '\n';
+            *(dst++) = '"';
         }
 
-        if (buffer[i] < 32 || buffer[i] == '"' || buffer[i] == '\\' || buffer[i] > 126) {
-            fprintf(env->out, "\\%03o", (unsigned char)buffer[i]);
-            env->line += 4;
-        } else if (i > 0 && buffer[i - 1] == '?' && buffer[i] == '?') { // Avoiding trigraph warnings
-            fprintf(env->out, "\\?");
-            env->line += 2;
-        } else {
-            fprintf(env->out, "%c", buffer[i]);
-            env->line++;
+        while (i < end && line < LINE_WIDTH)
+        {
+            unsigned char c = buffer[i++];
+
+            if (c == '?' && env->previous == '?') { // Avoiding trigraph warnings
+                *(dst++) = '\\';
+                *(dst++) = '?';
+                line += 2;
+                env->octal = 0;
+            } else if (env->octal && c >= '0' && c <= '7') { // Digit would extend the previous escape
+                *(dst++) = '\\';
+                *(dst++) = '6';
+                *(dst++) = c;
+                line += 3;
+            } else {
+                memcpy(dst, table->symbol[c], 8);
+                dst += table->length[c];
+                line += table->length[c];
+                env->octal = table->octal[c];
+            }
+
+            env->previous = c;
+            env->total++;
         }
 
-        if (l > 0 && ((i + l + 1) % STRING_LENGTH == 0)) {
-            fprintf(env->out, "\",");
-            env->line = 0;
-        } else if (env->line >= LINE_WIDTH) {
-            fprintf(env->out, "\"");
-            env->line = 0;
+        if (env->total % STRING_LENGTH == 0) {
+            *(dst++) = '"';
+            *(dst++) = ',';
+            line = 0;
+        } else if (line >= LINE_WIDTH) {
+            *(dst++) = '"';
+            line = 0;
         }
 
+        if (line == 0)
+            env->octal = 0;
+
+        env->out->length = dst - env->out->data;
+        env->line = line;
     }
 
-    env->total += len;
     return 1;
 }
 
-resource_data generate_resource(const char* filename, FILE* out)
+mz_bool array_callback(const void* data, int len, void *user)
 {
-    tdefl_compressor compressor;
-    char buffer[BUFFER_SIZE];
-
-    resource_data result;
-    compression_data cenv;
-    FILE* fp = fopen(filename, "rb");
-    size_t length = 0;
+    const unsigned char* buffer = (const unsigned char*) data;
+    compression_data* env = (compression_data*) user;
+    const encoding_table* table = env->table;
+    int i = 0;
 
-    if (!fp)
+    while (i < len)
     {
-        result.inflated = -1;
-        result.deflated = -1;
-        return result;
-    }
-
-    cenv.out = out;
-    cenv.line = 0;
-    cenv.total = 0;
-
-    tdefl_init(&compressor, &compression_callback, &cenv, TDEFL_MAX_PROBES_MASK);
-
-    while (1) {
-        size_t n = fread (buffer, sizeof(char), BUFFER_SIZE, fp);
-
-        if (n < 1) break;
+        char* dst;
+        int line = env->line;
 
-        tdefl_compress_buffer(&compressor, buffer, n, TDEFL_SYNC_FLUSH);
+        buffer_reserve(env->out, LINE_WIDTH + 16);
+        dst = &(env->out->data[env->out->length]);
 
-        length += n;
+        if (line == 0)
+            *(dst++) = '\n';
 
-        if (n < BUFFER_SIZE) {
-            break;
+        while (i < len && line < LINE_WIDTH)
+        {
+            unsigned char c = buffer[i++];
+            memcpy(dst, table->symbol[c], 8);
+            dst += table->length[c];
+            line += table->length[c];
         }
 
+        env->out->length = dst - env->out->data;
+        env->line = (line >= LINE_WIDTH) ? 0 : line;
     }
 
-    tdefl_compress_buffer(&compressor, NULL, 0, TDEFL_FINISH);
-
-    if (cenv.line < LINE_WIDTH && cenv.line != 0) {
-        fprintf(out, "\"");
-    }
+    env->total += len;
+    return 1;
+}
 
-    if ((cenv.total) % STRING_LENGTH != 0)
-        fprintf(out, ",\n");
+mz_bool raw_callback(const void* data, int len, void *user)
+{
+    compression_data* env = (compression_data*) user;
 
-    fclose(fp);
+    buffer_write(env->out, (const char*) data, len);
+    env->total += len;
 
-    result.metadata = 1;
-    result.inflated = length;
-    result.deflated = cenv.total;
-    return result;
+    return 1;
 }
 
-int source_callback(const void* data, int len, void *user)
+// Returns the callback that writes data in the given encoding
+tdefl_put_buf_func_ptr encoding_begin(compression_data* cenv, output_buffer* out, int encoding)
 {
-    source_data* env = (source_data*) user;
-    const char* buffer = (const char*) data;
-    int i = 0;
+    cenv->out = out;
+    cenv->line = 0;
+    cenv->total = 0;
+    cenv->previous = 0;
+    cenv->octal = 0;
 
-    // Copy the buffer to output and look for placeholder, replace it with data
-    while (i < len)
+    switch (encoding)
     {
-        // We are already recognizing placeholder
-        if (env->state > 0) {
-            if (buffer[i] == env->placeholder[env->state])
-            {
-                env->state++;
-            } else {
-                if (env->placeholder[env->state] == 0) // Placeholder recognized, insert data
-                {
+    case ENCODING_STRING:
+    case ENCODING_MINIMAL:
+        cenv->table = (encoding == ENCODING_STRING) ? &string_table : &minimal_table;
+        return &compression_callback;
+    case ENCODING_HEX:
+    case ENCODING_DECIMAL:
+        cenv->table = (encoding == ENCODING_HEX) ? &hex_table : &decimal_table;
+        return &array_callback;
+    default:
+        cenv->table = NULL;
+        return &raw_callback;
+    }
+}
 
-                    env->state = 0;
+void encoding_end(compression_data* cenv, int encoding)
+{
+    if (encoding == ENCODING_STRING || encoding == ENCODING_MINIMAL)
+    {
+        if (cenv->line < LINE_WIDTH && cenv->line != 0) {
+            buffer_write(cenv->out, "\"", 1);
+        }
 
-                    fprintf(env->out, "%s", env->identifier);
-                    fputc(buffer[i], env->out);
-                } else { // Not a placeholder, abort
-                    int j;
+        if ((cenv->total) % STRING_LENGTH != 0)
+            buffer_write(cenv->out, ",\n", 2);
+    }
+    else if ((encoding == ENCODING_HEX || encoding == ENCODING_DECIMAL) && cenv->total == 0)
+    {
+        // An empty initializer is not valid C, the padding byte is not part of the length
+        buffer_write(cenv->out, "0", 1);
+    }
+}
 
-                    for (j = 0; j < env->state; j++)
-                        fputc(env->placeholder[j], env->out);
+// Converts a level, a strategy and a codec to compressor flags, similar to zlib levels but with the highest level
+// using the maximal number of probes. Level 0 stores the data without compression.
+int compression_flags(int level, int strategy, int codec)
+{
+    static const int probes[11] = { 0, 1, 6, 32, 16, 32, 128, 256, 512, 1500, TDEFL_MAX_PROBES_MASK };
+    int flags;
 
-                    env->state = 0;
+    if (level <= 0)
+        return COMPRESSION_STORE;
 
-                    fputc(buffer[i], env->out);
-                }
+    flags = probes[level > 10 ? 10 : level] | ((level <= 3) ? TDEFL_GREEDY_PARSING_FLAG : 0);
 
-            }
-        } else {
-            if (buffer[i] == env->placeholder[0]) // Enter placeholder seek mode, pause output
-            {
-                env->state = 1;
-            } else { // Output normally
-                fputc(buffer[i], env->out);
-            }
-        }
-        i++;
+    // The fast codec searches matches in the same way, but has no strategies
+    if (codec == CODEC_LZ)
+        return flags | COMPRESSION_LZ;
+
+    switch (strategy)
+    {
+    case STRATEGY_FILTERED:
+        flags |= TDEFL_FILTER_MATCHES;
+        break;
+    case STRATEGY_HUFFMAN:
+        flags &= ~TDEFL_MAX_PROBES_MASK;
+        break;
+    case STRATEGY_RLE:
+        flags |= TDEFL_RLE_MATCHES;
+        break;
+    case STRATEGY_FIXED:
+        flags |= TDEFL_FORCE_ALL_STATIC_BLOCKS;
+        break;
+    case STRATEGY_OPTIMAL:
+        flags |= TDEFL_OPTIMAL_PARSING_FLAG;
+        break;
     }
 
-    return 1;
+    return flags;
 }
 
-int write_file(const char* source, data_callback callback, void* user)
+// Resources compressed with the fast codec are decompressed from a single array
+int fast_codec(int flags)
 {
-    char buffer[BUFFER_SIZE];
-    FILE* fp = fopen(source, "rb");
-    if (!fp)
-        return 0;
-    while (1) {
-        size_t n = fread (buffer, sizeof(char), BUFFER_SIZE, fp);
-        if (n < 1) break;
-        callback(buffer, n, user);
-        if (n < BUFFER_SIZE) break;
-    }
-    fclose(fp);
-    return 1;
+    return flags != COMPRESSION_STORE && (flags & COMPRESSION_LZ);
 }
 
-int help()
+// Compresses the next part of a resource with the fast codec in chunks of at most LZ_CHUNK_SIZE bytes that restart
+// at every block. A chunk that continues after the end of the data is only compressed if it is the last part of the
+// resource, otherwise it is left for the next call. Returns the number of bytes that were compressed.
+size_t compress_chunks(lz_compressor* lz, const char* data, size_t len, size_t position, int last, size_t block_size,
+    tdefl_put_buf_func_ptr callback, compression_data* cenv, resource_data* result)
 {
+    unsigned char* chunk = (unsigned char*) checked_allocation(malloc(LZ_BOUND(LZ_CHUNK_SIZE)));
+    size_t i = 0;
 
-    fprintf(stderr, "rescue - A cross-platform resource compiler.\n\n");
-    fprintf(stderr, "Usage: rescue [-h] [-v] [-o <path>] [-a] [-b] [-r <path>] [-p <prefix>] <file1> ...\n");
-    fprintf(stderr, " -h\t\tPrint help.\n");
-    fprintf(stderr, " -v\t\tBe verbose.\n");
-    fprintf(stderr, " -o <path>\tOutput the resulting C source to the given file instead of printing it to standard output.\n\t\tThis flag can only be used before any source file is provided.\n");
-    // NOT IMPLEMENTED YET!
-    //fprintf(stderr, " -r <path>\tSet the root direcotry for the following files.\n\t\tThe embedded names of the files will be relative to this path.\n");
-    fprintf(stderr, " -a\t\tSet the naming mode of the files to absolute name.\n\t\tThe embedded names of the files will include the full absolute name of the file.\n");
-    fprintf(stderr, " -b\t\tSet the naming mode of the files to file basename.\n\t\tThe embedded names of the files will include only the basename of the file.\n");
-    fprintf(stderr, " -p <prefix>\tUse the following alphanumerical string as a prefix for the functions and\n\t\tvariables in the generated file (instead of `rescue`).\n\t\tThis flag can only be used before any source file is provided.\n");
-    fprintf(stderr, "\n");
+    while (i < len)
+    {
+        size_t step = LZ_CHUNK_SIZE;
 
-}
+        if (block_size && step > block_size - (position % block_size))
+            step = block_size - (position % block_size);
 
-#define NAMING_MODE_ABSOLUTE 0
-#define NAMING_MODE_RELATIVE 1
-#define NAMING_MODE_BASENAME 2
+        if (step > len - i)
+        {
+            if (!last)
+                break;
+            step = len - i;
+        }
 
-#define MAX_IDENTIFIER 64
+        if (block_size && position % block_size == 0)
+        {
+            result->blocks = (size_t*) realloc(result->blocks, sizeof(size_t) * (result->block_count + 1));
+            result->blocks[result->block_count++] = cenv->total;
+        }
 
-#define VERBOSE(...) if (verbose) { fprintf(stderr, __VA_ARGS__); }
+        callback(chunk, (int) lz_compress_chunk(lz, (const unsigned char*) &data[i], step, chunk), cenv);
+        i += step;
+        position += step;
+    }
 
-int main(int argc, char** argv)
+    free(chunk);
+    return i;
+}
+
+// Estimates if compression is worth it by compressing a sample from the start of the file. If the sample is
+// the entire file, the compressed data is kept in the trial buffer so that it does not have to be compressed again.
+int trial_compression(tdefl_compressor* compressor, lz_compressor* lz, const char* data, size_t length, int complete, int flags,
+    const compression_settings* settings, output_buffer* trial)
 {
-    int i;
-    FILE* out = stdout;
-    char root[MAX_PATH];
-    char identifier[MAX_IDENTIFIER];
-    int processed_files = 0;
-    int naming_mode = NAMING_MODE_BASENAME;
-    source_data ctx;
-    int verbose = 0;
+    compression_data tenv;
+    size_t sample = (length < SAMPLE_SIZE) ? length : SAMPLE_SIZE;
 
-    char** resource_names = (char**) malloc(sizeof(char*) * argc);
-    int* resource_metadata = (int*) malloc(sizeof(int) * argc);
-    size_t* resource_length_inflated = (size_t*) malloc(sizeof(size_t) * argc);
-    size_t* resource_length_deflated = (size_t*) malloc(sizeof(size_t) * argc);
+    // Empty resources are always compressed as stored data would result in empty arrays
+    if (sample == 0)
+        return 1;
 
-    PWD(root, MAX_PATH); // Get the current directory
-    strcpy(identifier, DEFAULT_IDENTIFIER);
+    tenv.out = trial;
+    tenv.total = 0;
 
-    for (i = 1; i < argc; i++)
+    if (lz)
     {
-        if (strcmp(argv[i], "-h") == 0)
-        {
+        compress_chunks(lz, data, sample, 0, 1, 0, &raw_callback, &tenv, NULL);
+    } else
+    {
+        tdefl_init(compressor, &raw_callback, &tenv, flags);
+        if (settings->dictionary)
+            tdefl_set_dictionary(compressor, settings->dictionary, settings->dictionary_length);
+        tdefl_compress_buffer(compressor, data, sample, TDEFL_FINISH);
+    }
 
-            if (argc == 2) help();
-            continue;
+    if (!complete || sample < length)
+        trial->length = 0;
 
-        } else if (strcmp(argv[i], "-o") == 0)
+    return (size_t) tenv.total * 100 < sample * (size_t) (100 - settings->threshold);
+}
+
+// Compresses the next part of a resource that starts at the given position of the uncompressed data. Every block
+// ends with a full flush that aligns the output to a byte and resets the dictionary, so decompression can
+// start at the recorded offset of any block while the resource as a whole remains a single deflate stream.
+void compress_blocks(tdefl_compressor* compressor, const char* data, size_t len, size_t position, size_t block_size,
+    compression_data* cenv, resource_data* result)
+{
+    size_t i = 0;
+
+    while (i < len)
+    {
+        size_t step = block_size - (position % block_size);
+
+        if (position % block_size == 0)
         {
-            if (out != stdout)
-            {
-                fprintf(stderr, "Output already set.\n");
-                continue;
-            }
+            if (position > 0)
+                tdefl_compress_buffer(compressor, NULL, 0, TDEFL_FULL_FLUSH);
 
-            if (processed_files > 0)
-            {
-                fprintf(stderr, "Output already set.\n");
-                continue;
-            }
+            result->blocks = (size_t*) realloc(result->blocks, sizeof(size_t) * (result->block_count + 1));
+            result->blocks[result->block_count++] = cenv->total;
+        }
 
-            out = fopen(argv[++i], "wb");
+        if (step > len - i)
+            step = len - i;
 
-            VERBOSE("Writing to file %s.\n", argv[i]);
+        tdefl_compress_buffer(compressor, &data[i], step, TDEFL_NO_FLUSH);
+        i += step;
+        position += step;
+    }
+}
 
-            continue;
+// Encoding of the data of a resource, string segments are replaced by a byte array if the data has to be contiguous
+int resource_encoding(int encoding, int metadata)
+{
+    if ((metadata & META_CONTIGUOUS) && (encoding == ENCODING_STRING || encoding == ENCODING_MINIMAL))
+        return ENCODING_HEX;
 
-        } else if (strcmp(argv[i], "-v") == 0)
-        {
+    return encoding;
+}
 
-            verbose = 1;
+resource_data generate_resource(const char* filename, output_buffer* out, const compression_settings* settings, int flags)
+{
+    tdefl_compressor* compressor;
+    lz_compressor* lz = NULL;
+    char* buffer;
 
-            continue;
+    resource_data result;
+    compression_data cenv;
+    tdefl_put_buf_func_ptr callback;
+    output_buffer trial;
+    int compress;
+    int encoding = settings->encoding;
+    FILE* fp = fopen(filename, "rb");
+    size_t length = 0;
+    size_t kept = 0;
+    size_t n;
+    unsigned int crc;
 
-        } else if (strcmp(argv[i], "-b") == 0)
-        {
+    result.blocks = NULL;
+    result.block_count = 0;
 
-            naming_mode = NAMING_MODE_BASENAME;
+    if (!fp)
+    {
+        result.inflated = RESOURCE_FAILED;
+        result.deflated = RESOURCE_FAILED;
+        return result;
+    }
 
-            continue;
+    // The compressor state and input block are too large to have on every worker stack
+    compressor = (tdefl_compressor*) checked_allocation(malloc(sizeof(tdefl_compressor)));
+    buffer = (char*) checked_allocation(malloc(sizeof(char) * INPUT_BUFFER_SIZE));
 
-        } else if (strcmp(argv[i], "-a") == 0)
-        {
+    n = fread(buffer, sizeof(char), INPUT_BUFFER_SIZE, fp);
+    crc = (unsigned int) mz_crc32(MZ_CRC32_INIT, (const unsigned char*) buffer, n);
 
-            naming_mode = NAMING_MODE_ABSOLUTE;
+    // The encoding of resources with the fast codec does not depend on the data, as the header may already be written
+    if (fast_codec(flags))
+        encoding = resource_encoding(encoding, META_CONTIGUOUS);
 
-            continue;
+    // Empty resources are always compressed with deflate as stored data or the fast codec would result in empty arrays
+    if ((flags == COMPRESSION_STORE || fast_codec(flags)) && n == 0)
+        flags = 0;
 
-        } else if (strcmp(argv[i], "-r") == 0)
-        {
+    if (fast_codec(flags))
+    {
+        lz = (lz_compressor*) checked_allocation(malloc(sizeof(lz_compressor)));
+        lz_init(lz, flags & TDEFL_MAX_PROBES_MASK, !(flags & TDEFL_GREEDY_PARSING_FLAG));
+    }
 
-            if ((i + 1) == argc)
-            {
-                fprintf(stderr, "Missing directory.\n");
-                continue;
-            }
+    buffer_init(&trial, NULL);
+    if (flags == COMPRESSION_STORE)
+        compress = 0;
+    else
+        compress = trial_compression(compressor, lz, buffer, n, n < INPUT_BUFFER_SIZE && (!settings->block_size || n <= settings->block_size),
+            flags, settings, &trial);
 
-            strcpy(root, argv[++i]);
-            naming_mode = NAMING_MODE_RELATIVE;
+    if (!compress && settings->contiguous)
+        encoding = resource_encoding(encoding, META_CONTIGUOUS);
 
-            continue;
+    callback = encoding_begin(&cenv, out, encoding);
 
-        } else if (strcmp(argv[i], "-p") == 0)
+    if (compress && trial.length > 0)
+    {
+        // The entire file was compressed as a sample
+        callback(trial.data, (int) trial.length, &cenv);
+        length = n;
+    } else
+    {
+        if (compress && !lz)
         {
+            tdefl_init(compressor, callback, &cenv, flags);
+            if (settings->dictionary)
+                tdefl_set_dictionary(compressor, settings->dictionary, settings->dictionary_length);
+        }
 
-            if ((i + 1) == argc)
-            {
-                fprintf(stderr, "Missing identifier.\n");
-                continue;
-            }
+        // Input is read in large blocks and compressed as a single stream, flushing
+        // only at the end so that deflate can choose its own block boundaries
+        while (n > 0) {
+
+            kept = 0;
 
-            if (processed_files > 0)
+            if (compress && lz)
             {
-                fprintf(stderr, "Output has already started.\n");
-                continue;
+                // A chunk that continues after the buffer is moved to its start and compressed after the next read
+                size_t used = compress_chunks(lz, buffer, n, length, n < INPUT_BUFFER_SIZE, settings->block_size, callback, &cenv, &result);
+                kept = n - used;
+                memmove(buffer, &buffer[used], kept);
+                n = used;
             }
+            else if (compress && settings->block_size)
+                compress_blocks(compressor, buffer, n, length, settings->block_size, &cenv, &result);
+            else if (compress)
+                tdefl_compress_buffer(compressor, buffer, n, TDEFL_NO_FLUSH);
+            else
+                callback(buffer, (int) n, &cenv);
 
-            strcpy(identifier, argv[++i]);
+            length += n;
 
-            continue;
+            if (n + kept < INPUT_BUFFER_SIZE) {
+                break;
+            }
+
+            n = kept + fread (&buffer[kept], sizeof(char), INPUT_BUFFER_SIZE - kept, fp);
+            crc = (unsigned int) mz_crc32(crc, (const unsigned char*) &buffer[kept], n - kept);
+        }
+
+        if (compress && !lz)
+            tdefl_compress_buffer(compressor, NULL, 0, TDEFL_FINISH);
+    }
+
+    buffer_free(&trial);
+
+    encoding_end(&cenv, encoding);
+
+    fclose(fp);
+    free(compressor);
+    free(lz);
+    free(buffer);
+
+    if (compress && lz)
+        result.metadata = META_COMPRESSION | META_LZ;
+    else
+        result.metadata = compress ? (META_COMPRESSION | (settings->dictionary ? META_DICTIONARY : 0)) : 0;
+
+    if (encoding != ENCODING_STRING && encoding != ENCODING_MINIMAL)
+        result.metadata |= META_CONTIGUOUS;
+
+    if (result.block_count > 1)
+    {
+        result.metadata |= META_BLOCKS;
+    } else
+    {
+        free(result.blocks);
+        result.blocks = NULL;
+        result.block_count = 0;
+    }
+
+    result.inflated = length;
+    result.deflated = cenv.total;
+    result.crc = crc;
+    return result;
+}
+
+int hash_file(const char* filename, sha256_context* ctx)
+{
+    char* buffer;
+    FILE* fp = fopen(filename, "rb");
+
+    if (!fp)
+        return 0;
+
+    buffer = (char*) malloc(sizeof(char) * INPUT_BUFFER_SIZE);
+    while (1) {
+        size_t n = fread (buffer, sizeof(char), INPUT_BUFFER_SIZE, fp);
+        if (n < 1) break;
+        sha256_update(ctx, buffer, n);
+        if (n < INPUT_BUFFER_SIZE) break;
+    }
+    free(buffer);
+    fclose(fp);
+
+    return 1;
+}
+
+int cache_key(const char* filename, const compression_settings* settings, int flags, char* key)
+{
+    sha256_context ctx;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char header[128];
+    int i;
+
+    sprintf(header, "rescue %d %d %d %d %d %d %d %lu %d", CACHE_VERSION, settings->encoding, flags, STRING_LENGTH, LINE_WIDTH,
+        SAMPLE_SIZE, settings->threshold, (unsigned long) settings->block_size, settings->contiguous);
+
+    sha256_init(&ctx);
+    sha256_update(&ctx, header, strlen(header) + 1);
+
+    if (settings->dictionary)
+        sha256_update(&ctx, settings->dictionary, settings->dictionary_length);
+
+    if (!hash_file(filename, &ctx))
+        return 0;
+
+    sha256_final(&ctx, digest);
+
+    for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+        sprintf(&key[i * 2], "%02x", digest[i]);
+
+    return 1;
+}
+
+// Cache entries start with a line with the lengths, metadata, number of blocks and CRC, followed by a line
+// with the offset of every block and the encoded data
+int cache_load(const char* cache, const char* key, output_buffer* out, resource_data* result)
+{
+    char* path;
+    char header[128];
+    unsigned long inflated, deflated;
+    unsigned int crc;
+    int metadata, block_count, b;
+    size_t* blocks = NULL;
+    FILE* fp;
+
+    path_join(cache, key, &path);
+    fp = fopen(path, "rb");
+    free(path);
+
+    if (!fp)
+        return 0;
+
+    if (!fgets(header, sizeof(header), fp) || sscanf(header, "%lu %lu %d %d %u", &inflated, &deflated, &metadata, &block_count, &crc) != 5)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    if (block_count > 0)
+        blocks = (size_t*) malloc(sizeof(size_t) * block_count);
+
+    for (b = 0; b < block_count; b++)
+    {
+        unsigned long block;
+
+        if (!fgets(header, sizeof(header), fp) || sscanf(header, "%lu", &block) != 1)
+        {
+            fclose(fp);
+            free(blocks);
+            return 0;
+        }
+
+        blocks[b] = block;
+    }
+
+    while (1) {
+        size_t n;
+        buffer_reserve(out, INPUT_BUFFER_SIZE);
+        n = fread(&(out->data[out->length]), sizeof(char), INPUT_BUFFER_SIZE, fp);
+        out->length += n;
+        if (n < INPUT_BUFFER_SIZE) break;
+    }
+
+    if (ferror(fp))
+    {
+        fclose(fp);
+        free(blocks);
+        out->length = 0;
+        return 0;
+    }
+
+    fclose(fp);
+
+    result->inflated = inflated;
+    result->deflated = deflated;
+    result->metadata = metadata;
+    result->crc = crc;
+    result->blocks = blocks;
+    result->block_count = block_count;
+    return 1;
+}
+
+// Entries are written to a temporary file first so that concurrent runs never see a partial entry
+int cache_store(const char* cache, const char* key, output_buffer* data, resource_data* result)
+{
+    char* path;
+    char* temporary;
+    FILE* fp;
+    int success, b;
+
+    path_join(cache, key, &path);
+    temporary = (char*) malloc(sizeof(char) * (strlen(path) + 64));
+    sprintf(temporary, "%s.%d.%lx.tmp", path, PROCESS_ID(), (unsigned long) (size_t) data);
+
+    fp = fopen(temporary, "wb");
+
+    if (!fp)
+    {
+        free(path);
+        free(temporary);
+        return 0;
+    }
+
+    fprintf(fp, "%lu %lu %d %d %u\n", (unsigned long) result->inflated, (unsigned long) result->deflated, result->metadata, result->block_count, result->crc);
+    for (b = 0; b < result->block_count; b++)
+        fprintf(fp, "%lu\n", (unsigned long) result->blocks[b]);
+    fwrite(data->data, sizeof(char), data->length, fp);
+    success = !ferror(fp);
+    success = (fclose(fp) == 0) && success;
+
+    if (!success || rename(temporary, path) != 0)
+    {
+        remove(temporary);
+        success = 0;
+    }
+
+    free(path);
+    free(temporary);
+    return success;
+}
+
+// Compresses a resource into memory, using the cache if given
+void compress_job(resource_job* job, const compression_settings* settings, const char* cache)
+{
+    char key[CACHE_KEY_LENGTH + 1];
+
+    buffer_init(&job->data, NULL);
+    job->cached = 0;
+
+    if (cache && cache_key(job->filename, settings, job->flags, key))
+    {
+        if (cache_load(cache, key, &job->data, &job->result))
+        {
+            job->cached = 1;
+            return;
+        }
+
+        job->result = generate_resource(job->filename, &job->data, settings, job->flags);
+
+        if (job->result.deflated != RESOURCE_FAILED)
+            cache_store(cache, key, &job->data, &job->result);
+
+        return;
+    }
+
+    job->result = generate_resource(job->filename, &job->data, settings, job->flags);
+}
+
+THREAD_FUNCTION(resource_worker, user)
+{
+    worker_pool* pool = (worker_pool*) user;
+
+    while (1)
+    {
+        resource_job* job;
+
+        MUTEX_LOCK(pool->mutex);
+
+        // Finished jobs keep their data until they are written, so workers do not run too far ahead of the writer
+        while (pool->next < pool->count && pool->next >= pool->written + pool->window)
+            CONDITION_WAIT(pool->progress, pool->mutex);
+
+        if (pool->next >= pool->count)
+        {
+            MUTEX_UNLOCK(pool->mutex);
+            break;
+        }
+        job = &(pool->jobs[pool->next++]);
+        MUTEX_UNLOCK(pool->mutex);
+
+        // Duplicates use the data of the original job
+        if (job->duplicate < 0)
+            compress_job(job, pool->settings, pool->cache);
+
+        MUTEX_LOCK(pool->mutex);
+        job->done = 1;
+        CONDITION_BROADCAST(pool->finished);
+        MUTEX_UNLOCK(pool->mutex);
+    }
+
+    THREAD_RETURN;
+}
+
+int source_callback(const void* data, int len, void *user)
+{
+    source_data* env = (source_data*) user;
+    const char* buffer = (const char*) data;
+    int i = 0;
+
+    // Copy the buffer to output and look for placeholder, replace it with data
+    while (i < len)
+    {
+        // We are already recognizing placeholder
+        if (env->state > 0) {
+            if (buffer[i] == env->placeholder[env->state])
+            {
+                env->state++;
+            } else {
+                if (env->placeholder[env->state] == 0) // Placeholder recognized, insert data
+                {
+
+                    env->state = 0;
+
+                    fprintf(env->out, "%s", env->identifier);
+                    fputc(buffer[i], env->out);
+                } else { // Not a placeholder, abort
+                    int j;
+
+                    for (j = 0; j < env->state; j++)
+                        fputc(env->placeholder[j], env->out);
+
+                    env->state = 0;
+
+                    fputc(buffer[i], env->out);
+                }
+
+            }
+        } else {
+            if (buffer[i] == env->placeholder[0]) // Enter placeholder seek mode, pause output
+            {
+                env->state = 1;
+            } else { // Output normally
+                fputc(buffer[i], env->out);
+            }
+        }
+        i++;
+    }
+
+    return 1;
+}
+
+int write_file(const char* source, data_callback callback, void* user)
+{
+    char buffer[BUFFER_SIZE];
+    FILE* fp = fopen(source, "rb");
+    if (!fp)
+        return 0;
+    while (1) {
+        size_t n = fread (buffer, sizeof(char), BUFFER_SIZE, fp);
+        if (n < 1) break;
+        callback(buffer, n, user);
+        if (n < BUFFER_SIZE) break;
+    }
+    fclose(fp);
+    return 1;
+}
+
+int help()
+{
+
+    fprintf(stderr, "rescue - A cross-platform resource compiler.\n\n");
+    fprintf(stderr, "Usage: rescue [-h] [-v] [-o <path>] [-a] [-b] [-r <path>] [-i <pattern>] [-x <pattern>] [-p <prefix>] [-j <jobs>] [-e <encoding>] [-f <format>] [-MD] [-MF <path>] [--if-changed] [--cache <dir>] [-l <level>] [--strategy <strategy>] [--codec <codec>] [--store-threshold <percent>] [--dictionary <size>] [--block-size <size>] [--contiguous] <file1|dir1|@list1> ...\n");
+    fprintf(stderr, " -h\t\tPrint help.\n");
+    fprintf(stderr, " -v\t\tBe verbose.\n");
+    fprintf(stderr, " -o <path>\tOutput the resulting C source to the given file instead of printing it to standard output.\n\t\tThis flag can only be used before any source file is provided.\n");
+    fprintf(stderr, " -r <path>\tSet the root directory for the following files.\n\t\tThe embedded names of the files will be relative to this path.\n");
+    fprintf(stderr, " -a\t\tSet the naming mode of the files to absolute name.\n\t\tThe embedded names of the files will include the full absolute name of the file.\n");
+    fprintf(stderr, " -b\t\tSet the naming mode of the files to file basename.\n\t\tThe embedded names of the files will include only the basename of the file.\n");
+    fprintf(stderr, " -i <pattern>\tOnly include files matching the pattern (`*` and `?` wildcards) from the\n\t\tfollowing directories. Can be given multiple times.\n");
+    fprintf(stderr, " -x <pattern>\tExclude files and directories matching the pattern from the following\n\t\tdirectories. Can be given multiple times.\n");
+    fprintf(stderr, " @<path>\tRead the inputs from the given file, one file or directory per line.\n\t\tLines with `-l <level>`, `--strategy <strategy>` or `--codec <codec>` apply\n\t\tto the following lines.\n");
+    fprintf(stderr, " -p <prefix>\tUse the following alphanumerical string as a prefix for the functions and\n\t\tvariables in the generated file (instead of `rescue`).\n\t\tThis flag can only be used before any source file is provided.\n");
+    fprintf(stderr, " -j <jobs>\tCompress the files using the given number of parallel workers.\n\t\tThe output is identical to the output of a single worker.\n");
+    fprintf(stderr, " -e <encoding>\tSet the encoding of the data in the C source: `string` (default, octal escapes),\n\t\t`minimal` (string with shortest escapes), `hex` or `decimal` (byte arrays) or\n\t\t`embed` (C23 #embed of a file with the same path and a `.bin` extension).\n");
+    fprintf(stderr, " -MD\t\tWrite a Makefile dependency file listing all resources next to the output\n\t\tfile (with a `.d` extension appended).\n");
+    fprintf(stderr, " -MF <path>\tWrite the dependency file to the given path.\n");
+    fprintf(stderr, " --if-changed\tOnly replace the output files if their content has changed.\n");
+    fprintf(stderr, " --cache <dir>\tStore the compressed data in the given directory and reuse it for files\n\t\twith the same content and settings in later runs.\n");
+    fprintf(stderr, " -l <level>\tSet the compression level of the following files from 0 (no compression)\n\t\tto 10 (default, best compression). Levels 1 to 3 are faster.\n");
+    fprintf(stderr, " --strategy <strategy>\n\t\tSet the compression strategy of the following files: `default`,\n\t\t`filtered`, `huffman` (no matches), `rle` (only runs), `fixed` (static codes)\n\t\tor `optimal` (smallest output, many times slower).\n");
+    fprintf(stderr, " --codec <codec>\n\t\tSet the codec of the following files: `deflate` (default) or `lz` (no\n\t\tentropy coding, larger but several times faster to decompress).\n");
+    fprintf(stderr, " --store-threshold <percent>\n\t\tStore files uncompressed if compression reduces the size of a sample\n\t\tby less than the given percentage (default 5).\n");
+    fprintf(stderr, " --dictionary <size>\n\t\tTrain a dictionary of the given size (1024 to 32768 bytes) from the small\n\t\tfiles and use it to compress all files, improves the ratio of small files.\n");
+    fprintf(stderr, " --block-size <size>\n\t\tCompress files larger than the given size (at least 4096 bytes) in blocks\n\t\tof this size that can be decompressed independently for range reads.\n");
+    fprintf(stderr, " --contiguous\tWrite the data of uncompressed files as byte arrays so that it can be used\n\t\tin place with `get_pointer`, even with the `string` and `minimal` encodings.\n");
+    fprintf(stderr, " -f <format>\tSet the output format, either `c` (default) or `elf`. In the `elf` format the\n\t\tresource data is written to the output file as an ELF object and the\n\t\tC source with access functions to the same path with a `.c` extension.\n");
+    fprintf(stderr, "\n");
+
+}
+
+#define NAMING_MODE_ABSOLUTE 0
+#define NAMING_MODE_RELATIVE 1
+#define NAMING_MODE_BASENAME 2
+
+#define MAX_IDENTIFIER 64
+
+#define VERBOSE(...) if (verbose) { fprintf(stderr, __VA_ARGS__); }
+
+// Replaces the extension of a path if it matches, otherwise the new extension is appended
+char* replace_extension(const char* path, const char* from, const char* to)
+{
+    size_t len = strlen(path);
+    size_t flen = strlen(from);
+    char* result = (char*) malloc(sizeof(char) * (len + strlen(to) + 1));
+
+    strcpy(result, path);
+    if (len > flen && strcmp(&result[len - flen], from) == 0)
+        result[len - flen] = 0;
+    strcat(result, to);
+
+    return result;
+}
+
+// Opens an output file, if it should only be replaced when its content changes a temporary file is used instead
+FILE* open_output(const char* path, int if_changed)
+{
+    FILE* fp;
+    char* temporary;
+
+    if (!if_changed)
+        return fopen(path, "wb");
+
+    temporary = replace_extension(path, "", ".tmp");
+    fp = fopen(temporary, "w+b");
+    free(temporary);
+    return fp;
+}
+
+// Closes an output file, returns 1 if it has been written, 0 if the existing file has been kept because the
+// content is the same and -1 if writing failed
+int close_output(FILE* fp, const char* path, int if_changed)
+{
+    char* temporary;
+    FILE* existing;
+    int same = 0;
+    int failed = ferror(fp);
+
+    if (!if_changed)
+    {
+        failed = (fclose(fp) != 0) || failed;
+        return failed ? -1 : 1;
+    }
+
+    temporary = replace_extension(path, "", ".tmp");
+    existing = fopen(path, "rb");
+
+    if (existing)
+    {
+        char* a = (char*) malloc(sizeof(char) * INPUT_BUFFER_SIZE);
+        char* b = (char*) malloc(sizeof(char) * INPUT_BUFFER_SIZE);
+
+        fflush(fp);
+        fseek(fp, 0, SEEK_SET);
+        same = 1;
+
+        while (same)
+        {
+            size_t na = fread(a, sizeof(char), INPUT_BUFFER_SIZE, fp);
+            size_t nb = fread(b, sizeof(char), INPUT_BUFFER_SIZE, existing);
+            if (na != nb || memcmp(a, b, na) != 0)
+                same = 0;
+            if (na < INPUT_BUFFER_SIZE)
+                break;
+        }
+
+        free(a);
+        free(b);
+        fclose(existing);
+    }
+
+    failed = (fclose(fp) != 0) || failed;
+
+    if (same || failed)
+    {
+        remove(temporary);
+    } else
+    {
+#ifdef RESCUE_WINDOWS
+        // Only POSIX rename replaces an existing file
+        remove(path);
+#endif
+        if (rename(temporary, path) != 0)
+        {
+            remove(temporary);
+            failed = 1;
+        }
+    }
+
+    free(temporary);
+    return failed ? -1 : !same;
+}
+
+// Closes an output file and reports if it is unchanged or cannot be written, returns 0 in the latter case
+int finish_output(FILE* fp, const char* path, int if_changed, int verbose)
+{
+    int result = close_output(fp, path, if_changed);
+
+    if (result < 0)
+        fprintf(stderr, "Unable to write to file %s.\n", path);
+    else if (result == 0)
+        VERBOSE("File %s has not changed.\n", path);
+
+    return result >= 0;
+}
+
+// Writes a Makefile rule with all the resources as prerequisites of the generated files
+int write_dependencies(const char* path, const char* output, const char* source, const char* sidecar, const char** files, int count)
+{
+    const char* c;
+    const char* targets[3];
+    int t, failed;
+    FILE* fp = fopen(path, "wb");
+
+    if (!fp)
+        return 0;
+
+    targets[0] = output;
+    targets[1] = source;
+    targets[2] = sidecar;
+
+    for (t = 0; t < 3 + count; t++)
+    {
+        const char* name = (t < 3) ? targets[t] : files[t - 3];
+
+        if (!name)
+            continue;
+
+        if (t == 3)
+            fprintf(fp, ":");
+
+        if (t >= 3)
+            fprintf(fp, " \\\n ");
+        else if (t > 0)
+            fprintf(fp, " ");
+
+        for (c = name; *c; c++)
+        {
+            if (*c == ' ' || *c == '#')
+                fputc('\\', fp);
+            if (*c == '$')
+                fputc('$', fp);
+            fputc(*c, fp);
+        }
+    }
+
+    if (count == 0)
+        fprintf(fp, ":");
+
+    fprintf(fp, "\n");
+
+    failed = ferror(fp);
+    failed = (fclose(fp) != 0) || failed;
+
+    return !failed;
+}
+
+// Declaration that precedes the data of a resource
+void resource_header(output_buffer* out, int encoding, const char* identifier, int index)
+{
+    char header[MAX_IDENTIFIER + 64];
+
+    switch (encoding)
+    {
+    case ENCODING_STRING:
+    case ENCODING_MINIMAL:
+        sprintf(header, "static const char* %s_resource_data_%d[] = {", identifier, index);
+        break;
+    case ENCODING_HEX:
+    case ENCODING_DECIMAL:
+        sprintf(header, "static const unsigned char %s_resource_bytes_%d[] = {", identifier, index);
+        break;
+    default:
+        return;
+    }
+
+    buffer_write(out, header, strlen(header));
+}
+
+// Closes the data of a resource, contiguous data gets a table with a single segment
+void resource_footer(output_buffer* out, int encoding, const char* identifier, int index, size_t offset)
+{
+    char footer[2 * MAX_IDENTIFIER + 128];
+
+    switch (encoding)
+    {
+    case ENCODING_STRING:
+    case ENCODING_MINIMAL:
+        strcpy(footer, " 0};\n");
+        break;
+    case ENCODING_HEX:
+    case ENCODING_DECIMAL:
+        sprintf(footer, "};\nstatic const char* %s_resource_data_%d[] = {(const char*) %s_resource_bytes_%d, 0};\n",
+            identifier, index, identifier, index);
+        break;
+    case ENCODING_EMBED:
+        sprintf(footer, "static const char* %s_resource_data_%d[] = {(const char*) %s_resource_embed + %lu, 0};\n",
+            identifier, index, identifier, (unsigned long) offset);
+        break;
+    default:
+        return;
+    }
+
+    buffer_write(out, footer, strlen(footer));
+}
+
+// Writes the data tables of all resources to an object, the compressed data of every resource
+// has already been written to .rodata at the given offset
+int write_object(elf_writer* elf, const char* identifier, int count, char** names, int* metadata,
+    size_t* inflated, size_t* deflated, size_t* offsets, int* shared, size_t dictionary)
+{
+    int f;
+    size_t s;
+    char symbol[MAX_IDENTIFIER + 32];
+    elf_uint64 position;
+    elf_uint64* name_offsets = (elf_uint64*) malloc(sizeof(elf_uint64) * count);
+    elf_uint64* segment_offsets = (elf_uint64*) malloc(sizeof(elf_uint64) * count);
+
+    for (f = 0; f < count; f++)
+        name_offsets[f] = elf_rodata_write(elf, names[f], strlen(names[f]) + 1);
+
+    position = elf_rodata_align(elf, 8);
+    for (f = 0; f < count; f++)
+        elf_rodata_integer(elf, metadata[f], sizeof(int));
+    elf_rodata_integer(elf, 0, sizeof(int));
+    sprintf(symbol, "%s_resource_metadata", identifier);
+    elf_symbol(elf, symbol, ELF_SECTION_RODATA, position, (count + 1) * sizeof(int));
+
+    position = elf_rodata_align(elf, 8);
+    for (f = 0; f < count; f++)
+        elf_rodata_integer(elf, inflated[f], sizeof(size_t));
+    elf_rodata_integer(elf, 0, sizeof(size_t));
+    sprintf(symbol, "%s_resource_length_inflated", identifier);
+    elf_symbol(elf, symbol, ELF_SECTION_RODATA, position, (count + 1) * sizeof(size_t));
+
+    position = elf_rodata_offset(elf);
+    for (f = 0; f < count; f++)
+        elf_rodata_integer(elf, deflated[f], sizeof(size_t));
+    elf_rodata_integer(elf, 0, sizeof(size_t));
+    sprintf(symbol, "%s_resource_length_deflated", identifier);
+    elf_symbol(elf, symbol, ELF_SECTION_RODATA, position, (count + 1) * sizeof(size_t));
+
+    // Segments point into the contiguous data of a resource so that the layout matches the C format
+    for (f = 0; f < count; f++)
+    {
+        // Resources with the same content share their segments
+        if (shared[f] != f)
+        {
+            segment_offsets[f] = segment_offsets[shared[f]];
+            continue;
+        }
+
+        segment_offsets[f] = elf_relro_offset(elf);
+        for (s = 0; s < deflated[f]; s += STRING_LENGTH)
+            elf_relro_pointer(elf, ELF_SECTION_RODATA, offsets[f] + s);
+        elf_relro_null(elf);
+    }
+
+    position = elf_relro_offset(elf);
+    for (f = 0; f < count; f++)
+        elf_relro_pointer(elf, ELF_SECTION_RELRO, segment_offsets[f]);
+    elf_relro_null(elf);
+    sprintf(symbol, "%s_resource_data", identifier);
+    elf_symbol(elf, symbol, ELF_SECTION_RELRO, position, (count + 1) * 8);
+
+    // The dictionary is at the start of the data
+    if (dictionary > 0)
+    {
+        position = elf_relro_offset(elf);
+        for (s = 0; s < dictionary; s += STRING_LENGTH)
+            elf_relro_pointer(elf, ELF_SECTION_RODATA, s);
+        elf_relro_null(elf);
+        sprintf(symbol, "%s_resource_dictionary", identifier);
+        elf_symbol(elf, symbol, ELF_SECTION_RELRO, position, elf_relro_offset(elf) - position);
+    }
+
+    position = elf_relro_offset(elf);
+    for (f = 0; f < count; f++)
+        elf_relro_pointer(elf, ELF_SECTION_RODATA, name_offsets[f]);
+    elf_relro_null(elf);
+    sprintf(symbol, "%s_resource_names", identifier);
+    elf_symbol(elf, symbol, ELF_SECTION_RELRO, position, (count + 1) * 8);
+
+    free(name_offsets);
+    free(segment_offsets);
+
+    return elf_end(elf);
+}
+
+typedef struct input_state {
+    resource_job* jobs;
+    int count;
+    int capacity;
+    int naming_mode;
+    int level;
+    int strategy;
+    int codec;
+    char root[ABSOLUTE_PATH_LENGTH];
+    char** includes;
+    int include_count;
+    char** excludes;
+    int exclude_count;
+    char** manifests;
+    int manifest_count;
+} input_state;
+
+typedef struct directory_entry {
+    char* name;
+    int directory;
+    long size; // Size of a file if the listing provides it or -1
+} directory_entry;
+
+// Directories that are being scanned, from the current one to the input, so that links to a parent are not followed
+typedef struct directory_chain {
+#ifndef RESCUE_WINDOWS
+    dev_t device;
+    ino_t inode;
+#endif
+    const struct directory_chain* parent;
+} directory_chain;
+
+char* copy_string(const char* str)
+{
+    char* copy = (char*) malloc(sizeof(char) * (strlen(str) + 1));
+    strcpy(copy, str);
+    return copy;
+}
+
+void append_string(char*** list, int* count, const char* str)
+{
+    *list = (char**) realloc(*list, sizeof(char*) * (*count + 1));
+    (*list)[(*count)++] = copy_string(str);
+}
+
+// Matches a wildcard pattern where '*' matches any sequence of characters and '?' a single character
+int match_pattern(const char* pattern, const char* text)
+{
+    const char* star = NULL;
+    const char* resume = NULL;
+
+    while (*text)
+    {
+        if (*pattern == '*')
+        {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' || *pattern == *text)
+        {
+            pattern++;
+            text++;
+        } else if (star)
+        {
+            pattern = star + 1;
+            text = ++resume;
+        } else
+        {
+            return 0;
+        }
+    }
+
+    while (*pattern == '*')
+        pattern++;
+
+    return *pattern == 0;
+}
+
+// Patterns match either the path relative to the scanned directory or just the name of the entry
+int match_any(char** patterns, int count, const char* relative, const char* name)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        if (match_pattern(patterns[i], relative) || match_pattern(patterns[i], name))
+            return 1;
+    }
+    return 0;
+}
+
+int compare_entries(const void* a, const void* b)
+{
+    return strcmp(((const directory_entry*) a)->name, ((const directory_entry*) b)->name);
+}
+
+// Lists a directory, the type of entries is taken from the listing itself where possible to avoid a stat per file
+int read_directory(const char* path, directory_entry** entries, int* count)
+{
+    int capacity = 0;
+#ifdef RESCUE_WINDOWS
+    WIN32_FIND_DATA data;
+    HANDLE handle;
+    char* pattern;
+
+    path_join(path, "*", &pattern);
+    handle = FindFirstFile(pattern, &data);
+    free(pattern);
+
+    if (handle == INVALID_HANDLE_VALUE)
+        return 0;
+
+    *entries = NULL;
+    *count = 0;
+
+    do {
+        const char* name = data.cFileName;
+#else
+    struct dirent* entry;
+    DIR* dir = opendir(path);
+
+    if (!dir)
+        return 0;
+
+    *entries = NULL;
+    *count = 0;
+
+    while ((entry = readdir(dir)) != NULL) {
+        const char* name = entry->d_name;
+#endif
+        directory_entry* e;
+
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            *entries = (directory_entry*) realloc(*entries, sizeof(directory_entry) * capacity);
+        }
+
+        e = &((*entries)[(*count)++]);
+        e->name = copy_string(name);
+        e->size = -1;
+
+#ifdef RESCUE_WINDOWS
+        // Links and junctions are not followed, they may point to a parent
+        e->directory = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 && !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+        if (!e->directory && data.nFileSizeHigh == 0 && data.nFileSizeLow <= 0x7fffffff)
+            e->size = (long) data.nFileSizeLow;
+    } while (FindNextFile(handle, &data));
+
+    FindClose(handle);
+#else
+#ifdef DT_DIR
+        if (entry->d_type == DT_DIR || entry->d_type == DT_REG)
+        {
+            e->directory = entry->d_type == DT_DIR;
+        } else
+#endif
+        {
+            char* full;
+            path_join(path, name, &full);
+            e->directory = is_directory(full);
+            free(full);
+        }
+    }
+
+    closedir(dir);
+#endif
+
+    // Entries are sorted so that the output does not depend on the order of the file system
+    qsort(*entries, *count, sizeof(directory_entry), compare_entries);
+
+    return 1;
+}
+
+// Name of a file relative to the root directory, both paths have to be absolute
+char* relative_name(const char* absolute, const char* root)
+{
+    size_t len = strlen(root);
+    char* name;
+    char* c;
+
+    while (len > 0 && IS_PATH_DELIMITER(root[len - 1]))
+        len--;
+
+    if (strncmp(absolute, root, len) == 0 && IS_PATH_DELIMITER(absolute[len]))
+        name = copy_string(&absolute[len + 1]);
+    else
+        name = copy_string(absolute);
+
+    // Embedded names always use forward slashes
+    for (c = name; *c; c++)
+    {
+        if (IS_PATH_DELIMITER(*c))
+            *c = '/';
+    }
+
+    return name;
+}
+
+// Adds a file to the list of resources, the absolute path and the size may be provided if already known
+void queue_file(input_state* inputs, const char* path, const char* absolute, long size)
+{
+    resource_job* job;
+
+    if (inputs->count == inputs->capacity)
+    {
+        inputs->capacity = inputs->capacity ? inputs->capacity * 2 : 64;
+        inputs->jobs = (resource_job*) checked_allocation(realloc(inputs->jobs, sizeof(resource_job) * inputs->capacity));
+    }
+
+    job = &(inputs->jobs[inputs->count++]);
+    job->filename = copy_string(path);
+    job->name = NULL;
+    job->flags = compression_flags(inputs->level, inputs->strategy, inputs->codec);
+    job->size = size;
+    job->duplicate = -1;
+    job->cached = 0;
+    job->done = 0;
+
+    switch (inputs->naming_mode)
+    {
+    case NAMING_MODE_BASENAME:
+    {
+        path_split(path, NULL, &job->name);
+        break;
+    }
+    case NAMING_MODE_RELATIVE:
+    case NAMING_MODE_ABSOLUTE:
+    {
+        char* abspath;
+        if (absolute)
+        {
+            abspath = copy_string(absolute);
+        } else
+        {
+            abspath = (char*) malloc(sizeof(char) * ABSOLUTE_PATH_LENGTH);
+            if (!ABSOLUTE_PATH(path, abspath, ABSOLUTE_PATH_LENGTH))
+            {
+                free(abspath);
+                abspath = copy_string(path);
+            }
+        }
+
+        if (inputs->naming_mode == NAMING_MODE_RELATIVE)
+        {
+            job->name = relative_name(abspath, inputs->root);
+            free(abspath);
+        } else
+        {
+            job->name = abspath;
+        }
+        break;
+    }
+    }
+}
+
+void scan_directory(input_state* inputs, const char* path, const char* relative, const char* absolute, const directory_chain* parent)
+{
+    directory_entry* entries;
+    directory_chain current;
+    int count, i;
+
+#ifndef RESCUE_WINDOWS
+    // A directory that is reached again through a symbolic link would be scanned until the path is too long
+    struct stat s;
+    const directory_chain* ancestor;
+
+    if (stat(path, &s) != 0)
+    {
+        fprintf(stderr, "Directory %s cannot be read, skipping.\n", path);
+        return;
+    }
+
+    for (ancestor = parent; ancestor; ancestor = ancestor->parent)
+    {
+        if (ancestor->device == s.st_dev && ancestor->inode == s.st_ino)
+        {
+            fprintf(stderr, "Directory %s links to one of its parents, skipping.\n", path);
+            return;
+        }
+    }
+
+    current.device = s.st_dev;
+    current.inode = s.st_ino;
+#endif
+    current.parent = parent;
+
+    if (!read_directory(path, &entries, &count))
+    {
+        fprintf(stderr, "Directory %s cannot be read, skipping.\n", path);
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        char *child, *child_relative, *child_absolute;
+
+        path_join(path, entries[i].name, &child);
+        path_join(absolute, entries[i].name, &child_absolute);
+        if (relative)
+            path_join(relative, entries[i].name, &child_relative);
+        else
+            child_relative = copy_string(entries[i].name);
+
+        if (!match_any(inputs->excludes, inputs->exclude_count, child_relative, entries[i].name))
+        {
+            if (entries[i].directory)
+            {
+                scan_directory(inputs, child, child_relative, child_absolute, &current);
+            } else if (inputs->include_count == 0 || match_any(inputs->includes, inputs->include_count, child_relative, entries[i].name))
+            {
+                queue_file(inputs, child, child_absolute, entries[i].size);
+            }
+        }
+
+        free(child);
+        free(child_relative);
+        free(child_absolute);
+        free(entries[i].name);
+    }
+
+    free(entries);
+}
+
+// Adds a file or all files in a directory
+void queue_input(input_state* inputs, const char* path)
+{
+    if (is_directory(path))
+    {
+        char* absolute = (char*) malloc(sizeof(char) * ABSOLUTE_PATH_LENGTH);
+
+        if (!ABSOLUTE_PATH(path, absolute, ABSOLUTE_PATH_LENGTH))
+        {
+            free(absolute);
+            absolute = copy_string(path);
+        }
+
+        scan_directory(inputs, path, NULL, absolute, NULL);
+        free(absolute);
+    } else
+    {
+        queue_file(inputs, path, NULL, -1);
+    }
+}
+
+int set_level(input_state* inputs, const char* value)
+{
+    char* end;
+    long level = strtol(value, &end, 10);
+
+    if (*value == 0 || *end != 0 || level < 0 || level > 10)
+    {
+        fprintf(stderr, "Compression level must be between 0 and 10.\n");
+        return 0;
+    }
+
+    inputs->level = (int) level;
+    return 1;
+}
+
+int set_strategy(input_state* inputs, const char* value)
+{
+    if (strcmp(value, "default") == 0)
+        inputs->strategy = STRATEGY_DEFAULT;
+    else if (strcmp(value, "filtered") == 0)
+        inputs->strategy = STRATEGY_FILTERED;
+    else if (strcmp(value, "huffman") == 0)
+        inputs->strategy = STRATEGY_HUFFMAN;
+    else if (strcmp(value, "rle") == 0)
+        inputs->strategy = STRATEGY_RLE;
+    else if (strcmp(value, "fixed") == 0)
+        inputs->strategy = STRATEGY_FIXED;
+    else if (strcmp(value, "optimal") == 0)
+        inputs->strategy = STRATEGY_OPTIMAL;
+    else
+    {
+        fprintf(stderr, "Unknown strategy %s.\n", value);
+        return 0;
+    }
+
+    return 1;
+}
+
+int set_codec(input_state* inputs, const char* value)
+{
+    if (strcmp(value, "deflate") == 0)
+        inputs->codec = CODEC_DEFLATE;
+    else if (strcmp(value, "lz") == 0)
+        inputs->codec = CODEC_LZ;
+    else
+    {
+        fprintf(stderr, "Unknown codec %s.\n", value);
+        return 0;
+    }
+
+    return 1;
+}
+
+// Lines starting with a dash set the compression of the following entries in the manifest, e.g. "-l 1" or "--strategy rle"
+void manifest_option(input_state* inputs, char* line, const char* path, int number)
+{
+    char* value = line;
+
+    while (*value && *value != ' ' && *value != '\t')
+        value++;
+
+    while (*value == ' ' || *value == '\t')
+        *(value++) = 0;
+
+    if (strcmp(line, "-l") == 0)
+        set_level(inputs, value);
+    else if (strcmp(line, "--strategy") == 0)
+        set_strategy(inputs, value);
+    else if (strcmp(line, "--codec") == 0)
+        set_codec(inputs, value);
+    else
+        fprintf(stderr, "Unknown option %s in %s on line %d.\n", line, path, number);
+}
+
+// Adds all inputs listed in a manifest file, one per line, empty lines and lines starting with # are ignored
+int read_manifest(input_state* inputs, const char* path)
+{
+    char line[MAX_PATH];
+    int level = inputs->level;
+    int strategy = inputs->strategy;
+    int codec = inputs->codec;
+    int number = 0;
+    FILE* fp = fopen(path, "rb");
+
+    if (!fp)
+        return 0;
+
+    while (fgets(line, MAX_PATH, fp))
+    {
+        size_t len = strlen(line);
+
+        number++;
+
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+
+        if (len == 0 || line[0] == '#')
+            continue;
+
+        if (line[0] == '-')
+        {
+            manifest_option(inputs, line, path, number);
+            continue;
+        }
+
+        queue_input(inputs, line);
+    }
+
+    // Options in a manifest only apply to its own entries
+    inputs->level = level;
+    inputs->strategy = strategy;
+    inputs->codec = codec;
+
+    fclose(fp);
+    append_string(&inputs->manifests, &inputs->manifest_count, path);
+
+    return 1;
+}
+
+// Hash of a resource name, the generated lookup uses the same function
+mz_uint32 name_hash(mz_uint32 seed, const char* name)
+{
+    mz_uint32 hash = (2166136261u ^ seed) * 16777619u;
+
+    while (*name)
+    {
+        hash ^= (unsigned char) *(name++);
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+
+    return hash;
+}
+
+typedef struct perfect_hash {
+    int buckets;
+    int slots;
+    int* displacement; // Seed of the second hash for each bucket or -(slot + 1) for buckets with a single name
+    int* index; // Resource in each slot
+    int* sorted; // Resources with unique names in the order of names
+} perfect_hash;
+
+typedef struct hash_entry {
+    int bucket;
+    int size;
+    int index;
+    const char* name;
+} hash_entry;
+
+int compare_hash_names(const void* a, const void* b)
+{
+    const hash_entry* ea = (const hash_entry*) a;
+    const hash_entry* eb = (const hash_entry*) b;
+    int result = strcmp(ea->name, eb->name);
+    return result ? result : ea->index - eb->index;
+}
+
+int compare_hash_buckets(const void* a, const void* b)
+{
+    const hash_entry* ea = (const hash_entry*) a;
+    const hash_entry* eb = (const hash_entry*) b;
+
+    if (ea->size != eb->size)
+        return eb->size - ea->size;
+
+    if (ea->bucket != eb->bucket)
+        return ea->bucket - eb->bucket;
+
+    return ea->index - eb->index;
+}
+
+// Builds a minimal perfect hash of the names with hash and displace. Names are distributed to buckets by the
+// first hash, then for each bucket, starting with the largest, a seed is searched that moves all of its names
+// to free slots. Only the first of the resources with the same name can be found.
+void build_perfect_hash(char** names, int count, perfect_hash* hash)
+{
+    hash_entry* entries = (hash_entry*) malloc(sizeof(hash_entry) * (count + 1));
+    int* sizes;
+    char* occupied;
+    int unique = 0;
+    int i, j, k, free_slot = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        entries[i].index = i;
+        entries[i].name = names[i];
+    }
+
+    qsort(entries, count, sizeof(hash_entry), compare_hash_names);
+
+    for (i = 0; i < count; i++)
+    {
+        if (unique > 0 && strcmp(entries[i].name, entries[unique - 1].name) == 0)
+        {
+            fprintf(stderr, "Resource name %s is used more than once, only the first resource can be accessed.\n", entries[i].name);
+            continue;
+        }
+        entries[unique++] = entries[i];
+    }
+
+    hash->sorted = (int*) malloc(sizeof(int) * (unique + 1));
+    for (i = 0; i < unique; i++)
+        hash->sorted[i] = entries[i].index;
+
+    hash->slots = unique;
+    hash->buckets = unique / 4 + 1;
+    hash->displacement = (int*) calloc(hash->buckets, sizeof(int));
+    hash->index = (int*) malloc(sizeof(int) * (unique + 1));
+
+    sizes = (int*) calloc(hash->buckets, sizeof(int));
+    occupied = (char*) calloc(unique + 1, sizeof(char));
+
+    for (i = 0; i < unique; i++)
+    {
+        entries[i].bucket = (int) (name_hash(0, entries[i].name) % hash->buckets);
+        sizes[entries[i].bucket]++;
+    }
+
+    for (i = 0; i < unique; i++)
+        entries[i].size = sizes[entries[i].bucket];
+
+    qsort(entries, unique, sizeof(hash_entry), compare_hash_buckets);
+
+    for (i = 0; i < unique; i = j)
+    {
+        for (j = i + 1; j < unique && entries[j].bucket == entries[i].bucket; j++);
+
+        if (j - i == 1)
+        {
+            // Single names are placed directly into the remaining slots
+            while (occupied[free_slot])
+                free_slot++;
+
+            occupied[free_slot] = 1;
+            hash->index[free_slot] = entries[i].index;
+            hash->displacement[entries[i].bucket] = -(free_slot + 1);
+            continue;
+        }
+
+        for (hash->displacement[entries[i].bucket] = 1; ; hash->displacement[entries[i].bucket]++)
+        {
+            mz_uint32 seed = (mz_uint32) hash->displacement[entries[i].bucket];
+
+            for (k = i; k < j; k++)
+            {
+                int slot = (int) (name_hash(seed, entries[k].name) % unique);
+
+                if (occupied[slot])
+                    break;
+
+                occupied[slot] = 1;
+                hash->index[slot] = entries[k].index;
+            }
+
+            if (k == j)
+                break;
+
+            // Release the slots taken by this attempt
+            while (--k >= i)
+                occupied[name_hash(seed, entries[k].name) % unique] = 0;
+        }
+    }
+
+    free(occupied);
+    free(sizes);
+    free(entries);
+}
+
+typedef struct file_size {
+    long size;
+    int flags;
+    int job;
+    unsigned char digest[SHA256_DIGEST_SIZE];
+} file_size;
+
+int compare_sizes(const void* a, const void* b)
+{
+    const file_size* fa = (const file_size*) a;
+    const file_size* fb = (const file_size*) b;
+
+    if (fa->size != fb->size)
+        return (fa->size < fb->size) ? -1 : 1;
+
+    return fa->job - fb->job;
+}
+
+// Orders files of the same size by their content and flags, then by position
+int compare_contents(const void* a, const void* b)
+{
+    const file_size* fa = (const file_size*) a;
+    const file_size* fb = (const file_size*) b;
+    int c;
+
+    if (fa->size != fb->size)
+        return (fa->size < fb->size) ? -1 : 1;
+
+    if (fa->flags != fb->flags)
+        return (fa->flags < fb->flags) ? -1 : 1;
+
+    c = memcmp(fa->digest, fb->digest, SHA256_DIGEST_SIZE);
+    if (c != 0)
+        return c;
+
+    return fa->job - fb->job;
+}
+
+// Finds jobs with identical content and compression flags so that their data is only compressed and written
+// once. Only files that have the same size as some other file are hashed. Returns the number of duplicates.
+int find_duplicates(resource_job* jobs, int count)
+{
+    int i, j, k;
+    int duplicates = 0;
+    file_size* sizes = (file_size*) malloc(sizeof(file_size) * (count + 1));
+
+    if (!sizes)
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        sizes[i].job = i;
+        sizes[i].flags = jobs[i].flags;
+        sizes[i].size = jobs[i].size >= 0 ? jobs[i].size : file_length(jobs[i].filename);
+        jobs[i].duplicate = -1;
+    }
+
+    qsort(sizes, count, sizeof(file_size), compare_sizes);
+
+    for (i = 0; i < count; i = j)
+    {
+        for (j = i + 1; j < count && sizes[j].size == sizes[i].size; j++);
+
+        if (j - i < 2 || sizes[i].size < 0)
+            continue;
+
+        for (k = i; k < j; k++)
+        {
+            sha256_context ctx;
+            sha256_init(&ctx);
+            if (!hash_file(jobs[sizes[k].job].filename, &ctx))
+                sizes[k].size = -1;
+            sha256_final(&ctx, sizes[k].digest);
+        }
+
+        // Identical files are neighbours after sorting, the first of them is the original as it comes first in the output
+        qsort(&sizes[i], j - i, sizeof(file_size), compare_contents);
+
+        for (k = i + 1; k < j; k++)
+        {
+            const file_size* previous = &sizes[k - 1];
+
+            if (sizes[k].size < 0 || previous->size != sizes[k].size || previous->flags != sizes[k].flags
+                || memcmp(previous->digest, sizes[k].digest, SHA256_DIGEST_SIZE) != 0)
+                continue;
+
+            jobs[sizes[k].job].duplicate = (jobs[previous->job].duplicate >= 0) ? jobs[previous->job].duplicate : previous->job;
+            duplicates++;
+        }
+    }
+
+    free(sizes);
+
+    return duplicates;
+}
+
+typedef struct dictionary_segment {
+    size_t position;
+    unsigned long score;
+} dictionary_segment;
+
+int compare_segments(const void* a, const void* b)
+{
+    const dictionary_segment* sa = (const dictionary_segment*) a;
+    const dictionary_segment* sb = (const dictionary_segment*) b;
+
+    if (sa->score != sb->score)
+        return (sa->score < sb->score) ? -1 : 1;
+
+    return (sa->position < sb->position) ? -1 : 1;
+}
+
+unsigned int dmer_hash(const unsigned char* data)
+{
+    unsigned long long value = 0;
+    int i;
+    for (i = 0; i < TRAINING_DMER; i++)
+        value = (value << 8) | data[i];
+    return (unsigned int) ((value * 0x9E3779B97F4A7C15ULL) >> (64 - TRAINING_HASH_BITS));
+}
+
+// Trains a dictionary from the content of small files. The training data is split into epochs and in each
+// one the segment whose substrings appear in the largest number of files is selected, the substrings of
+// selected segments are not counted again. The segments are ordered so that the most useful ones are at
+// the end of the dictionary where matches have the shortest distances. Returns the number of files used.
+int train_dictionary(resource_job* jobs, int count, size_t size, char** dictionary, size_t* length)
+{
+    unsigned char* samples = NULL;
+    size_t* ends = (size_t*) malloc(sizeof(size_t) * (count + 1));
+    size_t total = 0, capacity = 0;
+    int used = 0;
+    unsigned int* frequency;
+    int* last;
+    unsigned int* hashes;
+    dictionary_segment* segments;
+    int segment_count = 0, epochs;
+    size_t epoch, p;
+    int i, e;
+
+    for (i = 0; i < count && total < TRAINING_DATA_LIMIT; i++)
+    {
+        FILE* fp;
+        size_t n;
+
+        // The fast codec does not use the dictionary
+        if (jobs[i].duplicate >= 0 || jobs[i].flags == COMPRESSION_STORE || fast_codec(jobs[i].flags))
+            continue;
+
+        fp = fopen(jobs[i].filename, "rb");
+
+        if (!fp)
+            continue;
+
+        if (capacity < total + TRAINING_FILE_LIMIT + 1)
+        {
+            capacity = (total + TRAINING_FILE_LIMIT + 1) * 2;
+            samples = (unsigned char*) realloc(samples, capacity);
+        }
+
+        // Files that do not fit in the limit are skipped, they gain little from a dictionary
+        n = fread(&samples[total], sizeof(char), TRAINING_FILE_LIMIT + 1, fp);
+        fclose(fp);
+
+        if (n == 0 || n > TRAINING_FILE_LIMIT)
+            continue;
+
+        total += n;
+        ends[used++] = total;
+    }
+
+    if (used < 2 || total < TRAINING_SEGMENT * 2)
+    {
+        free(samples);
+        free(ends);
+        return 0;
+    }
+
+    frequency = (unsigned int*) calloc(1 << TRAINING_HASH_BITS, sizeof(unsigned int));
+    last = (int*) malloc(sizeof(int) * (1 << TRAINING_HASH_BITS));
+    hashes = (unsigned int*) malloc(sizeof(unsigned int) * total);
+
+    for (p = 0; p < (1 << TRAINING_HASH_BITS); p++)
+        last[p] = -1;
+
+    // Count the number of files that contain each substring, substrings that span two files are ignored
+    for (p = 0, i = 0; p < total; p++)
+    {
+        if (p >= ends[i])
+            i++;
+
+        if (p + TRAINING_DMER > ends[i])
+        {
+            hashes[p] = (unsigned int) -1;
+            continue;
+        }
+
+        hashes[p] = dmer_hash(&samples[p]);
+
+        if (last[hashes[p]] != i)
+        {
+            last[hashes[p]] = i;
+            frequency[hashes[p]]++;
+        }
+    }
+
+    epochs = (int) (size / TRAINING_SEGMENT);
+    epoch = total / epochs;
+    if (epoch < TRAINING_SEGMENT)
+    {
+        epoch = TRAINING_SEGMENT;
+        epochs = (int) (total / epoch);
+    }
+
+    segments = (dictionary_segment*) malloc(sizeof(dictionary_segment) * epochs);
+
+    for (e = 0; e < epochs; e++)
+    {
+        size_t begin = e * epoch;
+        size_t end = begin + epoch;
+        size_t best = begin;
+        unsigned long best_score = 0, score = 0;
+
+        if (end > total)
+            end = total;
+
+        // Sliding sum of the frequencies of all substrings that start within the segment
+        for (p = begin; p < end; p++)
+        {
+            if (hashes[p] != (unsigned int) -1 && frequency[hashes[p]] > 1)
+                score += frequency[hashes[p]];
+
+            if (p >= begin + TRAINING_SEGMENT)
+            {
+                size_t q = p - TRAINING_SEGMENT;
+                if (hashes[q] != (unsigned int) -1 && frequency[hashes[q]] > 1)
+                    score -= frequency[hashes[q]];
+            }
+
+            if (p + 1 >= begin + TRAINING_SEGMENT && score > best_score)
+            {
+                best_score = score;
+                best = p + 1 - TRAINING_SEGMENT;
+            }
+        }
+
+        if (best_score == 0)
+            continue;
+
+        segments[segment_count].position = best;
+        segments[segment_count].score = best_score;
+        segment_count++;
+
+        for (p = best; p < best + TRAINING_SEGMENT; p++)
+        {
+            if (hashes[p] != (unsigned int) -1)
+                frequency[hashes[p]] = 0;
+        }
+    }
+
+    qsort(segments, segment_count, sizeof(dictionary_segment), compare_segments);
+
+    *dictionary = (char*) malloc(sizeof(char) * (segment_count * TRAINING_SEGMENT + 1));
+    *length = 0;
+
+    for (e = 0; e < segment_count; e++)
+    {
+        memcpy(&((*dictionary)[*length]), &samples[segments[e].position], TRAINING_SEGMENT);
+        *length += TRAINING_SEGMENT;
+    }
+
+    free(segments);
+    free(hashes);
+    free(last);
+    free(frequency);
+    free(samples);
+    free(ends);
+
+    if (*length == 0)
+    {
+        free(*dictionary);
+        *dictionary = NULL;
+        return 0;
+    }
+
+    return used;
+}
+
+// The dictionary is written before the resources in the same encoding, as a table of segments like the data of a resource
+void write_dictionary(FILE* data, FILE* source, int encoding, const char* identifier, const char* dictionary, size_t length)
+{
+    output_buffer buffer;
+    compression_data cenv;
+    tdefl_put_buf_func_ptr callback;
+    char header[MAX_IDENTIFIER + 64];
+
+    buffer_init(&buffer, data);
+
+    if (encoding == ENCODING_STRING || encoding == ENCODING_MINIMAL)
+    {
+        sprintf(header, "static const char* %s_resource_dictionary[] = {", identifier);
+        buffer_write(&buffer, header, strlen(header));
+    } else if (encoding == ENCODING_HEX || encoding == ENCODING_DECIMAL)
+    {
+        sprintf(header, "static const unsigned char %s_resource_dictionary_bytes[] = {", identifier);
+        buffer_write(&buffer, header, strlen(header));
+    }
+
+    callback = encoding_begin(&cenv, &buffer, encoding);
+    callback(dictionary, (int) length, &cenv);
+    encoding_end(&cenv, encoding);
+
+    buffer_free(&buffer);
+
+    switch (encoding)
+    {
+    case ENCODING_STRING:
+    case ENCODING_MINIMAL:
+        fprintf(source, " 0};\n");
+        break;
+    case ENCODING_HEX:
+    case ENCODING_DECIMAL:
+        fprintf(source, "};\nstatic const char* %s_resource_dictionary[] = {(const char*) %s_resource_dictionary_bytes, 0};\n",
+            identifier, identifier);
+        break;
+    case ENCODING_EMBED:
+        fprintf(source, "static const char* %s_resource_dictionary[] = {(const char*) %s_resource_embed, 0};\n", identifier, identifier);
+        break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int i;
+    FILE* out = stdout;
+    char identifier[MAX_IDENTIFIER];
+    int processed_files = 0;
+    source_data ctx;
+    int verbose = 0;
+    int workers = 1;
+    int queued_files = 0;
+    input_state inputs;
+    resource_job* jobs;
+    double start = timestamp();
+    size_t total_inflated = 0, total_deflated = 0;
+    int format = FORMAT_C;
+    int encoding = ENCODING_STRING;
+    compression_settings settings;
+    const char* output = NULL;
+    char* source_path = NULL;
+    char* sidecar = NULL;
+    char* depfile = NULL;
+    int dependencies = 0;
+    int if_changed = 0;
+    int failed = 0;
+    FILE* source = NULL;
+    FILE* data = NULL;
+    size_t offset = 0;
+    const char* cache = NULL;
+    int cached_files = 0;
+    int stored_files = 0;
+    int duplicate_files = 0;
+    size_t duplicate_bytes = 0;
+    size_t dictionary_size = 0;
+    perfect_hash lookup;
+    char* dictionary = NULL;
+    elf_writer elf;
+
+    char** resource_names;
+    int* resource_metadata;
+    unsigned int* resource_crc;
+    size_t* resource_length_inflated;
+    size_t* resource_length_deflated;
+    size_t* resource_offset;
+    int* resource_shared;
+    int* resource_blocks;
+    size_t* block_offsets = NULL;
+    int block_total = 0;
+    const char** resource_files;
+
+    memset(&inputs, 0, sizeof(input_state));
+    inputs.naming_mode = NAMING_MODE_BASENAME;
+    inputs.level = DEFAULT_LEVEL;
+    inputs.strategy = STRATEGY_DEFAULT;
+    inputs.codec = CODEC_DEFLATE;
+    PWD(inputs.root, ABSOLUTE_PATH_LENGTH); // Get the current directory
+    strcpy(identifier, DEFAULT_IDENTIFIER);
+    encoding_init();
+
+    settings.threshold = DEFAULT_STORE_THRESHOLD;
+    settings.dictionary = NULL;
+    settings.dictionary_length = 0;
+    settings.block_size = 0;
+    settings.contiguous = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-h") == 0)
+        {
+
+            if (argc == 2) help();
+            continue;
+
+        } else if (strcmp(argv[i], "-o") == 0)
+        {
+            if (output)
+            {
+                fprintf(stderr, "Output already set.\n");
+                continue;
+            }
+
+            if (inputs.count > 0)
+            {
+                fprintf(stderr, "Output already set.\n");
+                continue;
+            }
+
+            output = argv[++i];
+
+            VERBOSE("Writing to file %s.\n", argv[i]);
+
+            continue;
+
+        } else if (strcmp(argv[i], "-v") == 0)
+        {
+
+            verbose = 1;
+
+            continue;
+
+        } else if (strcmp(argv[i], "-b") == 0)
+        {
+
+            inputs.naming_mode = NAMING_MODE_BASENAME;
+
+            continue;
+
+        } else if (strcmp(argv[i], "-a") == 0)
+        {
+
+            inputs.naming_mode = NAMING_MODE_ABSOLUTE;
+
+            continue;
+
+        } else if (strcmp(argv[i], "-r") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing directory.\n");
+                continue;
+            }
+
+            i++;
+
+            // Names are computed from absolute paths so that the root is compared in the same form
+            if (!ABSOLUTE_PATH(argv[i], inputs.root, ABSOLUTE_PATH_LENGTH))
+            {
+                fprintf(stderr, "Directory %s does not exist.\n", argv[i]);
+                continue;
+            }
+
+            inputs.naming_mode = NAMING_MODE_RELATIVE;
+
+            continue;
+
+        } else if (strcmp(argv[i], "-i") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing pattern.\n");
+                continue;
+            }
+
+            append_string(&inputs.includes, &inputs.include_count, argv[++i]);
+
+            continue;
+
+        } else if (strcmp(argv[i], "-x") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing pattern.\n");
+                continue;
+            }
+
+            append_string(&inputs.excludes, &inputs.exclude_count, argv[++i]);
+
+            continue;
+
+        } else if (argv[i][0] == '@')
+        {
+
+            if (!read_manifest(&inputs, &argv[i][1]))
+                fprintf(stderr, "File %s does not exist or cannot be opened for reading, skipping.\n", &argv[i][1]);
+
+            continue;
+
+        } else if (strcmp(argv[i], "-p") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing identifier.\n");
+                continue;
+            }
+
+            if (inputs.count > 0)
+            {
+                fprintf(stderr, "Output has already started.\n");
+                continue;
+            }
+
+            strcpy(identifier, argv[++i]);
+
+            continue;
+        } else if (strcmp(argv[i], "-j") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing number of jobs.\n");
+                continue;
+            }
+
+            workers = atoi(argv[++i]);
+
+            if (workers < 1)
+                workers = 1;
+
+            continue;
+        } else if (strcmp(argv[i], "-f") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing format.\n");
+                continue;
+            }
+
+            i++;
+
+            if (strcmp(argv[i], "c") == 0)
+                format = FORMAT_C;
+            else if (strcmp(argv[i], "elf") == 0)
+                format = FORMAT_ELF;
+            else
+                fprintf(stderr, "Unknown format %s.\n", argv[i]);
+
+            continue;
+        } else if (strcmp(argv[i], "-MD") == 0)
+        {
+
+            dependencies = 1;
+
+            continue;
+        } else if (strcmp(argv[i], "-MF") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing dependency file.\n");
+                continue;
+            }
+
+            free(depfile);
+            depfile = (char*) malloc(sizeof(char) * (strlen(argv[i + 1]) + 1));
+            strcpy(depfile, argv[++i]);
+            dependencies = 1;
+
+            continue;
+        } else if (strcmp(argv[i], "--if-changed") == 0)
+        {
+
+            if_changed = 1;
+
+            continue;
+        } else if (strcmp(argv[i], "--cache") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing cache directory.\n");
+                continue;
+            }
+
+            cache = argv[++i];
+            MAKE_DIRECTORY(cache);
+
+            continue;
+        } else if (strcmp(argv[i], "-l") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing compression level.\n");
+                continue;
+            }
+
+            set_level(&inputs, argv[++i]);
+
+            continue;
+        } else if (strcmp(argv[i], "--strategy") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing strategy.\n");
+                continue;
+            }
+
+            set_strategy(&inputs, argv[++i]);
+
+            continue;
+        } else if (strcmp(argv[i], "--codec") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing codec.\n");
+                continue;
+            }
+
+            set_codec(&inputs, argv[++i]);
+
+            continue;
+        } else if (strcmp(argv[i], "--dictionary") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing dictionary size.\n");
+                continue;
+            }
+
+            dictionary_size = (size_t) atol(argv[++i]);
+
+            if (dictionary_size != 0 && (dictionary_size < 1024 || dictionary_size > MAX_DICTIONARY_SIZE))
+            {
+                fprintf(stderr, "Dictionary size must be between 1024 and %d.\n", MAX_DICTIONARY_SIZE);
+                dictionary_size = 0;
+            }
+
+            continue;
+        } else if (strcmp(argv[i], "--block-size") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing block size.\n");
+                continue;
+            }
+
+            settings.block_size = (size_t) atol(argv[++i]);
+
+            if (settings.block_size != 0 && settings.block_size < MIN_BLOCK_SIZE)
+            {
+                fprintf(stderr, "Block size must be at least %d.\n", MIN_BLOCK_SIZE);
+                settings.block_size = 0;
+            }
+
+            continue;
+        } else if (strcmp(argv[i], "--contiguous") == 0)
+        {
+
+            settings.contiguous = 1;
+
+            continue;
+        } else if (strcmp(argv[i], "--store-threshold") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing threshold.\n");
+                continue;
+            }
+
+            settings.threshold = atoi(argv[++i]);
+
+            if (settings.threshold < 0 || settings.threshold > 100)
+            {
+                fprintf(stderr, "Threshold must be between 0 and 100.\n");
+                settings.threshold = DEFAULT_STORE_THRESHOLD;
+            }
+
+            continue;
+        } else if (strcmp(argv[i], "-e") == 0)
+        {
+
+            if ((i + 1) == argc)
+            {
+                fprintf(stderr, "Missing encoding.\n");
+                continue;
+            }
+
+            i++;
+
+            if (strcmp(argv[i], "string") == 0)
+                encoding = ENCODING_STRING;
+            else if (strcmp(argv[i], "minimal") == 0)
+                encoding = ENCODING_MINIMAL;
+            else if (strcmp(argv[i], "hex") == 0)
+                encoding = ENCODING_HEX;
+            else if (strcmp(argv[i], "decimal") == 0)
+                encoding = ENCODING_DECIMAL;
+            else if (strcmp(argv[i], "embed") == 0)
+                encoding = ENCODING_EMBED;
+            else
+                fprintf(stderr, "Unknown encoding %s.\n", argv[i]);
+
+            continue;
+        }
+
+        // queue resource, the name is determined by the naming mode at this position
+
+        queue_input(&inputs, argv[i]);
+    }
+
+    jobs = inputs.jobs;
+    queued_files = inputs.count;
+
+    resource_names = (char**) checked_allocation(malloc(sizeof(char*) * (queued_files + 1)));
+    resource_metadata = (int*) checked_allocation(malloc(sizeof(int) * (queued_files + 1)));
+    resource_crc = (unsigned int*) checked_allocation(malloc(sizeof(unsigned int) * (queued_files + 1)));
+    resource_length_inflated = (size_t*) checked_allocation(malloc(sizeof(size_t) * (queued_files + 1)));
+    resource_length_deflated = (size_t*) checked_allocation(malloc(sizeof(size_t) * (queued_files + 1)));
+    resource_offset = (size_t*) checked_allocation(malloc(sizeof(size_t) * (queued_files + 1)));
+    resource_shared = (int*) checked_allocation(malloc(sizeof(int) * (queued_files + 1)));
+    resource_blocks = (int*) checked_allocation(malloc(sizeof(int) * (queued_files + 1)));
+    resource_files = (const char**) checked_allocation(malloc(sizeof(char*) * (queued_files + inputs.manifest_count + 1)));
+
+    VERBOSE("Found %d input files.\n", queued_files);
+
+    if (output)
+    {
+        out = open_output(output, if_changed);
+
+        if (!out)
+        {
+            fprintf(stderr, "Unable to write to file %s.\n", output);
+            return -1;
+        }
+    }
+
+    if (queued_files > 0)
+    {
+        worker_pool pool;
+        thread_t* threads = NULL;
+        int started = 0;
+
+        if (format == FORMAT_ELF)
+            encoding = ENCODING_RAW;
+
+        pool.jobs = jobs;
+        settings.encoding = encoding;
+
+        pool.settings = &settings;
+        pool.cache = cache;
+        pool.count = queued_files;
+        pool.next = 0;
+        pool.written = 0;
+
+        if (workers > queued_files)
+            workers = queued_files;
+
+        duplicate_files = find_duplicates(jobs, queued_files);
+
+        if (duplicate_files > 0)
+            VERBOSE("Found %d duplicate files.\n", duplicate_files);
+
+        if (dictionary_size > 0)
+        {
+            int trained = train_dictionary(jobs, queued_files, dictionary_size, &dictionary, &settings.dictionary_length);
+
+            if (trained > 0)
+            {
+                settings.dictionary = dictionary;
+                VERBOSE("Trained a dictionary of %lu bytes from %d files.\n", (unsigned long) settings.dictionary_length, trained);
+            } else
+            {
+                fprintf(stderr, "Not enough small files to train a dictionary, compressing without one.\n");
+            }
+        }
+
+        source = out;
+        data = out;
+
+        if (format == FORMAT_ELF)
+        {
+            if (out == stdout)
+            {
+                fprintf(stderr, "The ELF format requires an output file.\n");
+                return -1;
+            }
+
+            if (!elf_begin(&elf, out, ELF_MACHINE_HOST))
+            {
+                fprintf(stderr, "The ELF format is not supported on this platform.\n");
+                return -1;
+            }
+
+            // The source is written next to the object
+            source_path = replace_extension(output, ".o", ".c");
+            source = open_output(source_path, if_changed);
+
+            if (!source)
+            {
+                fprintf(stderr, "Unable to write to file %s.\n", source_path);
+                return -1;
+            }
+
+            VERBOSE("Writing source to file %s.\n", source_path);
+        } else if (encoding == ENCODING_EMBED)
+        {
+            if (out == stdout)
+            {
+                fprintf(stderr, "The embed encoding requires an output file.\n");
+                return -1;
+            }
+
+            // The data of all resources is written to a single file next to the source
+            sidecar = replace_extension(output, ".c", ".bin");
+            data = open_output(sidecar, if_changed);
+
+            if (!data)
+            {
+                fprintf(stderr, "Unable to write to file %s.\n", sidecar);
+                return -1;
+            }
+
+            VERBOSE("Writing data to file %s.\n", sidecar);
         }
 
         ctx.state = 0;
-        ctx.out = out;
+        ctx.out = source;
         ctx.placeholder = PLACEHOLDER;
         ctx.identifier = identifier;
 
         // copy resource
 
-        if (processed_files == 0)
-        {
 #ifndef RESCUE_BOOTSTRAP
-            rescue_get_resource("inflate.c", &source_callback, &ctx);
+        rescue_get_resource("inflate.c", &source_callback, &ctx);
 #else
-            BOOTSTRAP_WRITE("inflate.c", &source_callback, &ctx);
+        BOOTSTRAP_WRITE("inflate.c", &source_callback, &ctx);
 #endif
-            fprintf(out, "#ifndef %s_header_only\n", identifier);
+        fprintf(source, "#ifndef %s_header_only\n", identifier);
+
+        if (encoding == ENCODING_EMBED)
+        {
+            char* name = NULL;
+            path_split(sidecar, NULL, &name);
+            fprintf(source, "static const unsigned char %s_resource_embed[] = {\n#embed \"%s\"\n};\n", identifier, name);
+            free(name);
+        }
 
+        if (settings.dictionary)
+        {
+            write_dictionary(data, source, encoding, identifier, settings.dictionary, settings.dictionary_length);
+            offset = settings.dictionary_length;
         }
 
+        // Resources are compressed by the workers into their own buffers and written
+        // in the order of arguments so that the output does not depend on scheduling.
+        if (workers > 1)
         {
-            fprintf(out, "static const char* %s_resource_data_%d[] = {", identifier, processed_files);
+            MUTEX_INIT(pool.mutex);
+            CONDITION_INIT(pool.finished);
+            CONDITION_INIT(pool.progress);
+
+            pool.window = WORKER_WINDOW * workers;
+            threads = (thread_t*) malloc(sizeof(thread_t) * workers);
+            for (started = 0; threads && started < workers; started++)
+            {
+                if (!THREAD_CREATE(threads[started], resource_worker, &pool))
+                    break;
+            }
 
-            VERBOSE("Generating resource from %s.\n", argv[i]);
-            resource_data r = generate_resource(argv[i], out);
-            fprintf(out, " 0};\n");
+            VERBOSE("Compressing with %d workers.\n", started);
+        }
 
+        for (i = 0; i < queued_files; i++)
+        {
+            resource_job* job = &jobs[i];
 
-            if (r.deflated == -1)
+            if (job->duplicate >= 0)
             {
-                fprintf(stderr, "File %s does not exist or cannot be opened for reading, skipping.\n", argv[i]);
+                resource_job* original = &jobs[job->duplicate];
+
+                if (original->result.deflated == RESOURCE_FAILED)
+                {
+                    fprintf(stderr, "File %s does not exist or cannot be opened for reading, skipping.\n", job->filename);
+                    free(job->name);
+                    continue;
+                }
+
+                VERBOSE("Resource %s has the same content as %s, sharing data.\n", job->filename, original->filename);
+
+                duplicate_bytes += original->result.deflated;
+
+                job->result = original->result;
+                job->index = processed_files;
+                resource_offset[processed_files] = resource_offset[original->index];
+                resource_shared[processed_files] = resource_shared[original->index];
+                resource_blocks[processed_files] = resource_blocks[original->index];
+                resource_files[processed_files] = job->filename;
+                resource_length_inflated[processed_files] = job->result.inflated;
+                resource_length_deflated[processed_files] = job->result.deflated;
+                resource_metadata[processed_files] = job->result.metadata;
+                resource_crc[processed_files] = job->result.crc;
+                resource_names[processed_files] = job->name;
+
+                processed_files++;
                 continue;
-            } else
+            }
+
+            VERBOSE("Generating resource from %s.\n", job->filename);
+
+            // Resources that are written in memory first can use a different encoding than the
+            // one that was selected, the header is only written once it is known
+            if (started > 0 || cache || settings.contiguous)
             {
-                resource_length_inflated[processed_files] = r.inflated;
-                resource_length_deflated[processed_files] = r.deflated;
-                resource_metadata[processed_files] = r.metadata;
-                switch (naming_mode)
+                if (started > 0)
                 {
-                case NAMING_MODE_BASENAME:
+                    MUTEX_LOCK(pool.mutex);
+                    pool.written = i;
+                    CONDITION_BROADCAST(pool.progress);
+                    while (!job->done)
+                        CONDITION_WAIT(pool.finished, pool.mutex);
+                    MUTEX_UNLOCK(pool.mutex);
+                } else
                 {
-                    path_split(argv[i], NULL, &resource_names[processed_files]);
-                    break;
+                    compress_job(job, &settings, cache);
                 }
-                case NAMING_MODE_RELATIVE:
+
+                if (job->result.deflated != RESOURCE_FAILED)
                 {
-                    //TODO: not implemented yet!
-                    break;
+                    output_buffer header;
+                    buffer_init(&header, data);
+                    resource_header(&header, resource_encoding(encoding, job->result.metadata), identifier, processed_files);
+                    buffer_free(&header);
+                    fwrite(job->data.data, sizeof(char), job->data.length, data);
                 }
-                case NAMING_MODE_ABSOLUTE:
+            } else
+            {
+                // Without workers the data is streamed to the output, the header stays in the
+                // buffer until the first flush so it can be discarded if the file cannot be read
+                buffer_init(&job->data, data);
+                resource_header(&job->data, resource_encoding(encoding, fast_codec(job->flags) ? META_CONTIGUOUS : 0), identifier, processed_files);
+
+                job->result = generate_resource(job->filename, &job->data, &settings, job->flags);
+
+                if (job->result.deflated == RESOURCE_FAILED)
+                    job->data.length = 0;
+            }
+
+            buffer_free(&job->data);
+
+            if (job->result.deflated == RESOURCE_FAILED)
+            {
+                fprintf(stderr, "File %s does not exist or cannot be opened for reading, skipping.\n", job->filename);
+                free(job->name);
+            } else
+            {
+                output_buffer footer;
+
+                if (job->cached)
                 {
-                    char* abspath = (char*) malloc(sizeof(char) * MAX_PATH);
-                    ABSOLUTE_PATH(argv[i], abspath, MAX_PATH);
-                    resource_names[processed_files] = abspath;
-                    break;
+                    VERBOSE("Using cached data for %s.\n", job->filename);
+                    cached_files++;
                 }
+
+                buffer_init(&footer, source);
+                resource_footer(&footer, resource_encoding(encoding, job->result.metadata), identifier, processed_files, offset);
+                buffer_free(&footer);
+
+                if (job->result.metadata & META_COMPRESSION)
+                {
+                    VERBOSE("Compressed %s from %lu to %lu bytes (%.1f%%).\n", job->filename, (unsigned long) job->result.inflated,
+                        (unsigned long) job->result.deflated, job->result.inflated ? (100.0 * job->result.deflated) / job->result.inflated : 100.0);
+                } else
+                {
+                    VERBOSE("Stored %s uncompressed (%lu bytes).\n", job->filename, (unsigned long) job->result.inflated);
+                    stored_files++;
                 }
 
+                total_inflated += job->result.inflated;
+                total_deflated += job->result.deflated;
+
+                job->index = processed_files;
+                resource_offset[processed_files] = offset;
+                resource_shared[processed_files] = processed_files;
+                resource_blocks[processed_files] = -1;
+
+                // The offsets of all blocks are collected in a single table
+                if (job->result.block_count > 0)
+                {
+                    VERBOSE("Compressed %s in %d blocks.\n", job->filename, job->result.block_count);
+
+                    block_offsets = (size_t*) realloc(block_offsets, sizeof(size_t) * (block_total + job->result.block_count));
+                    memcpy(&block_offsets[block_total], job->result.blocks, sizeof(size_t) * job->result.block_count);
+                    resource_blocks[processed_files] = block_total;
+                    block_total += job->result.block_count;
+
+                    free(job->result.blocks);
+                    job->result.blocks = NULL;
+                }
+                resource_files[processed_files] = job->filename;
+                resource_length_inflated[processed_files] = job->result.inflated;
+                resource_length_deflated[processed_files] = job->result.deflated;
+                resource_metadata[processed_files] = job->result.metadata;
+                resource_crc[processed_files] = job->result.crc;
+                resource_names[processed_files] = job->name;
+
+                offset += job->result.deflated;
+                processed_files++;
             }
+        }
 
+        if (workers > 1)
+        {
+            // Workers may still wait to take the duplicates at the end
+            MUTEX_LOCK(pool.mutex);
+            pool.written = queued_files;
+            CONDITION_BROADCAST(pool.progress);
+            MUTEX_UNLOCK(pool.mutex);
+
+            for (i = 0; i < started; i++)
+                THREAD_JOIN(threads[i]);
+            free(threads);
+
+            CONDITION_DESTROY(pool.progress);
+            CONDITION_DESTROY(pool.finished);
+            MUTEX_DESTROY(pool.mutex);
         }
 
-        processed_files++;
+        {
+            double elapsed = timestamp() - start;
+            VERBOSE("Compressed %d resources from %lu to %lu bytes (%.1f%%) in %.2f s (%.1f MB/s).\n", processed_files,
+                (unsigned long) total_inflated, (unsigned long) total_deflated, total_inflated ? (100.0 * total_deflated) / total_inflated : 100.0,
+                elapsed, elapsed > 0 ? total_inflated / (elapsed * 1024 * 1024) : 0.0);
+
+            if (duplicate_files > 0)
+                VERBOSE("Shared data of %d duplicate resources, saving %lu bytes.\n", duplicate_files, (unsigned long) duplicate_bytes);
+
+            if (stored_files > 0)
+                VERBOSE("Stored %d of %d resources uncompressed.\n", stored_files, processed_files);
+
+            if (cache)
+                VERBOSE("Used cached data for %d of %d resources.\n", cached_files, processed_files);
+        }
     }
 
+    if (queued_files > 0)
+        build_perfect_hash(resource_names, processed_files, &lookup);
+
+    if (queued_files > 0 && format == FORMAT_ELF)
+    {
+        int f;
+
+        if (!write_object(&elf, identifier, processed_files, resource_names, resource_metadata,
+            resource_length_inflated, resource_length_deflated, resource_offset, resource_shared, settings.dictionary_length))
+        {
+            fprintf(stderr, "Unable to write the object file.\n");
+            return -1;
+        }
+
+        fprintf(source, "extern const char** %s_resource_data[];\n", identifier);
+        fprintf(source, "extern const char* %s_resource_names[];\n", identifier);
+        fprintf(source, "extern const int %s_resource_metadata[];\n", identifier);
+        fprintf(source, "extern const size_t %s_resource_length_inflated[];\n", identifier);
+        fprintf(source, "extern const size_t %s_resource_length_deflated[];\n", identifier);
+
+        if (settings.dictionary)
+            fprintf(source, "extern const char* %s_resource_dictionary[];\n", identifier);
+
+        for (f = 0; f < processed_files; f++)
+            free(resource_names[f]);
 
-    if (processed_files > 0)
+    } else if (queued_files > 0)
     {
         int f;
 
         fprintf(out, "static const char** %s_resource_data[] = {", identifier);
         for (f = 0; f < processed_files; f++)
-            fprintf(out, "%s_resource_data_%d,", identifier, f);
+            fprintf(out, "%s_resource_data_%d,", identifier, resource_shared[f]);
         fprintf(out, " 0};\n");
 
         fprintf(out, "static const char* %s_resource_names[] = {\n", identifier);
         for (f = 0; f < processed_files; f++)
-            fprintf(out, "\"%s\",", resource_names[f]);
+        {
+            const char* c;
+            fputc('"', out);
+            for (c = resource_names[f]; *c; c++)
+            {
+                if (*c == '"' || *c == '\\')
+                    fputc('\\', out);
+                fputc(*c, out);
+            }
+            fprintf(out, "\",");
+        }
         fprintf(out, " 0};\n");
 
         fprintf(out, "static const int %s_resource_metadata[] = {\n", identifier);
@@ -489,17 +3172,69 @@ int main(int argc, char** argv)
             fprintf(out, "%ld,", resource_length_deflated[f]);
         fprintf(out, " 0};\n");
 
-        free(resource_length_inflated);
-        free(resource_length_deflated);
-        free(resource_metadata);
-
         for (f = 0; f < processed_files; f++)
             free(resource_names[f]);
-        free(resource_names);
 
-        fprintf(out, "#define %s_SEGMENT_LENGTH (%d)\n", identifier, STRING_LENGTH),
+    }
+
+    free(resource_length_inflated);
+    free(resource_length_deflated);
+    free(resource_metadata);
+    free(resource_offset);
+    free(resource_shared);
+    free(resource_names);
+
+    if (queued_files > 0)
+    {
+        fprintf(source, "static const int %s_resource_displacement[] = {\n", identifier);
+        for (i = 0; i < lookup.buckets; i++)
+            fprintf(source, "%d,", lookup.displacement[i]);
+        fprintf(source, " 0};\n");
+
+        fprintf(source, "static const int %s_resource_slots[] = {\n", identifier);
+        for (i = 0; i < lookup.slots; i++)
+            fprintf(source, "%d,", lookup.index[i]);
+        fprintf(source, " 0};\n");
+
+        fprintf(source, "static const int %s_resource_sorted[] = {\n", identifier);
+        for (i = 0; i < lookup.slots; i++)
+            fprintf(source, "%d,", lookup.sorted[i]);
+        fprintf(source, " 0};\n");
+
+        fprintf(source, "static const unsigned int %s_resource_crc[] = {\n", identifier);
+        for (i = 0; i < processed_files; i++)
+            fprintf(source, "%uu,", resource_crc[i]);
+        fprintf(source, " 0};\n");
+
+        free(lookup.displacement);
+        free(lookup.index);
+        free(lookup.sorted);
+
+        if (block_total > 0)
+        {
+            fprintf(source, "static const size_t %s_resource_blocks[] = {\n", identifier);
+            for (i = 0; i < block_total; i++)
+                fprintf(source, "%lu,", (unsigned long) block_offsets[i]);
+            fprintf(source, " 0};\n");
+
+            fprintf(source, "static const int %s_resource_block_index[] = {\n", identifier);
+            for (i = 0; i < processed_files; i++)
+                fprintf(source, "%d,", resource_blocks[i]);
+            fprintf(source, " 0};\n");
+        }
+
+        fprintf(source, "#define %s_HASH_BUCKETS (%d)\n", identifier, lookup.buckets);
+        fprintf(source, "#define %s_HASH_SLOTS (%d)\n", identifier, lookup.slots);
+        fprintf(source, "#define %s_SEGMENT_LENGTH (%d)\n", identifier, STRING_LENGTH);
+        fprintf(source, "#define %s_RESOURCE_COUNT (%d)\n", identifier, processed_files);
+
+        if (settings.dictionary)
+            fprintf(source, "#define %s_DICTIONARY_LENGTH (%lu)\n", identifier, (unsigned long) settings.dictionary_length);
+
+        if (block_total > 0)
+            fprintf(source, "#define %s_BLOCK_SIZE (%lu)\n", identifier, (unsigned long) settings.block_size);
 
-        fprintf(out, "#endif\n");
+        fprintf(source, "#endif\n");
 
 #ifndef RESCUE_BOOTSTRAP
         rescue_get_resource("template.c", &source_callback, &ctx);
@@ -507,6 +3242,15 @@ int main(int argc, char** argv)
         BOOTSTRAP_WRITE("template.c", &source_callback, &ctx);
 #endif
 
+        if (output)
+            VERBOSE("Wrote %ld bytes of source.\n", ftell(source));
+
+        if (source != out && !finish_output(source, source_path, if_changed, verbose))
+            failed = 1;
+
+        if (data != out && !finish_output(data, sidecar, if_changed, verbose))
+            failed = 1;
+
     }
 
     if (argc < 2) {
@@ -515,9 +3259,57 @@ int main(int argc, char** argv)
         return -1;
     }
 
-    fflush(out);
+    if (output && !finish_output(out, output, if_changed, verbose))
+        failed = 1;
 
-    return 0;
+    if (!output && (fflush(out) != 0 || ferror(out)))
+    {
+        fprintf(stderr, "Unable to write the output.\n");
+        failed = 1;
+    }
 
-}
+    if (dependencies)
+    {
+        if (!depfile && output)
+            depfile = replace_extension(output, "", ".d");
 
+        // Manifests are prerequisites as well since changing them changes the list of resources
+        for (i = 0; i < inputs.manifest_count; i++)
+            resource_files[processed_files + i] = inputs.manifests[i];
+
+        if (!output)
+        {
+            fprintf(stderr, "The dependency file requires an output file.\n");
+        } else if (!write_dependencies(depfile, output, source_path, sidecar, resource_files, processed_files + inputs.manifest_count))
+        {
+            fprintf(stderr, "Unable to write to file %s.\n", depfile);
+            failed = 1;
+        }
+    }
+
+    free(source_path);
+    free(sidecar);
+    free(depfile);
+    free(dictionary);
+    free(resource_files);
+    free(resource_blocks);
+    free(resource_crc);
+    free(block_offsets);
+
+    for (i = 0; i < queued_files; i++)
+        free(jobs[i].filename);
+    free(jobs);
+
+    for (i = 0; i < inputs.include_count; i++)
+        free(inputs.includes[i]);
+    for (i = 0; i < inputs.exclude_count; i++)
+        free(inputs.excludes[i]);
+    for (i = 0; i < inputs.manifest_count; i++)
+        free(inputs.manifests[i]);
+    free(inputs.includes);
+    free(inputs.excludes);
+    free(inputs.manifests);
+
+    return failed ? -1 : 0;
+
+}
@@ -0,0 +1,105 @@
+
+#include <string.h>
+#include "sha256.h"
+
+#define SHA256_ROTR(X, N) (((X) >> (N)) | ((X) << (32 - (N))))
+
+static const unsigned int sha256_constants[64] = {
+  0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+  0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+  0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+  0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+  0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+  0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+  0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+  0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2 };
+
+static void sha256_transform(sha256_context* ctx, const unsigned char* block)
+{
+    unsigned int w[64], a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        w[i] = ((unsigned int) block[i * 4] << 24) | ((unsigned int) block[i * 4 + 1] << 16) | ((unsigned int) block[i * 4 + 2] << 8) | block[i * 4 + 3];
+
+    for (i = 16; i < 64; i++)
+        w[i] = (SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7] +
+               (SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+
+    a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+    e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+
+    for (i = 0; i < 64; i++)
+    {
+        t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_constants[i] + w[i];
+        t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+    ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void sha256_init(sha256_context* ctx)
+{
+    static const unsigned int initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->length = 0;
+    ctx->used = 0;
+}
+
+void sha256_update(sha256_context* ctx, const void* data, size_t len)
+{
+    const unsigned char* bytes = (const unsigned char*) data;
+
+    ctx->length += len;
+
+    while (len > 0)
+    {
+        size_t n = 64 - ctx->used;
+        if (n > len)
+            n = len;
+
+        // Full blocks are processed in place without copying
+        if (ctx->used == 0 && n == 64)
+        {
+            sha256_transform(ctx, bytes);
+        } else
+        {
+            memcpy(&ctx->block[ctx->used], bytes, n);
+            ctx->used += n;
+            if (ctx->used == 64)
+            {
+                sha256_transform(ctx, ctx->block);
+                ctx->used = 0;
+            }
+        }
+
+        bytes += n;
+        len -= n;
+    }
+}
+
+void sha256_final(sha256_context* ctx, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    unsigned long long bits = ctx->length * 8;
+    int i;
+
+    ctx->block[ctx->used++] = 0x80;
+
+    if (ctx->used > 56)
+    {
+        memset(&ctx->block[ctx->used], 0, 64 - ctx->used);
+        sha256_transform(ctx, ctx->block);
+        ctx->used = 0;
+    }
+
+    memset(&ctx->block[ctx->used], 0, 56 - ctx->used);
+    for (i = 0; i < 8; i++)
+        ctx->block[56 + i] = (unsigned char) (bits >> (56 - 8 * i));
+    sha256_transform(ctx, ctx->block);
+
+    for (i = 0; i < 32; i++)
+        digest[i] = (unsigned char) (ctx->state[i / 4] >> (24 - 8 * (i % 4)));
+}
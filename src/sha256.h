@@ -0,0 +1,29 @@
+#ifndef _SHA256_H
+#define _SHA256_H
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHA256_DIGEST_SIZE 32
+
+typedef struct sha256_context {
+    unsigned int state[8];
+    unsigned long long length;
+    unsigned char block[64];
+    size_t used;
+} sha256_context;
+
+void sha256_init(sha256_context* ctx);
+
+void sha256_update(sha256_context* ctx, const void* data, size_t len);
+
+void sha256_final(sha256_context* ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
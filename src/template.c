@@ -10,14 +10,62 @@ extern "C" {
 
 typedef int (*rescue_data_callback)(const void* buffer, int len, void *user);
 
+typedef int (*rescue_list_callback)(const char* name, void *user);
+
+typedef void (*rescue_task)(void* context, int task);
+
+typedef void (*rescue_executor)(rescue_task task, void* context, int count, void *user);
+
+#ifndef RESCUE_ITERATOR_DEFINED
+#define RESCUE_ITERATOR_DEFINED
+typedef struct rescue_iterator { int position; int end; } rescue_iterator;
+#endif
+
+#ifndef RESCUE_READER_DEFINED
+#define RESCUE_READER_DEFINED
+typedef struct rescue_reader rescue_reader;
+#endif
+
 int __RESCUE_has_resource(const char* name);
 
 int __RESCUE_get_resource(const char* name, rescue_data_callback callback, void *user);
 
 int __RESCUE_copy_resource(const char* name, char** buffer, size_t* size);
 
+int __RESCUE_copy_into(const char* name, void* buffer, size_t capacity, size_t* length);
+
+int __RESCUE_copy_resource_parallel(const char* name, char** buffer, size_t* size, rescue_executor executor, void *user);
+
 int __RESCUE_get_length(const char* name, size_t* compressed, size_t* uncompressed);
 
+int __RESCUE_get_pointer(const char* name, const void** pointer, size_t* length);
+
+const void* __RESCUE_acquire(const char* name, size_t* size);
+
+void __RESCUE_release(const void* data);
+
+void __RESCUE_set_cache_budget(size_t bytes);
+
+void __RESCUE_set_verify(int enabled);
+
+rescue_reader* __RESCUE_open(const char* name);
+
+int __RESCUE_reopen(rescue_reader* reader, const char* name);
+
+size_t __RESCUE_read(rescue_reader* reader, void* buffer, size_t len);
+
+size_t __RESCUE_skip(rescue_reader* reader, size_t len);
+
+void __RESCUE_close(rescue_reader* reader);
+
+int __RESCUE_read_range(const char* name, size_t offset, size_t len, void* buffer);
+
+int __RESCUE_list(const char* prefix, rescue_list_callback callback, void *user);
+
+int __RESCUE_list_begin(const char* prefix, rescue_iterator* iterator);
+
+const char* __RESCUE_list_next(rescue_iterator* iterator);
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,28 +75,153 @@ int __RESCUE_get_length(const char* name, size_t* compressed, size_t* uncompress
 #else
 
 #define __RESCUE_META_COMPRESSION 1
+#define __RESCUE_META_DICTIONARY 2
+#define __RESCUE_META_BLOCKS 4
+#define __RESCUE_META_CONTIGUOUS 8
+#define __RESCUE_META_LZ 16
 #define __RESCUE_CHUNK_SIZE 32*1024
+#define __RESCUE_CACHE_HEADER 16
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define __RESCUE_ATOMIC_LOAD(P) _InterlockedCompareExchange(P, 0, 0)
+#define __RESCUE_ATOMIC_STORE(P, V) _InterlockedExchange(P, V)
+#define __RESCUE_ATOMIC_CAS(P, E, D) (_InterlockedCompareExchange(P, D, E) == (E))
+#define __RESCUE_ATOMIC_ADD(P, V) (_InterlockedExchangeAdd(P, V) + (V))
+#define __RESCUE_ATOMIC_LOAD_POINTER(P) _InterlockedCompareExchangePointer((void* volatile*) (P), NULL, NULL)
+#define __RESCUE_ATOMIC_STORE_POINTER(P, V) _InterlockedExchangePointer((void* volatile*) (P), V)
+#else
+#define __RESCUE_ATOMIC_LOAD(P) __atomic_load_n(P, __ATOMIC_ACQUIRE)
+#define __RESCUE_ATOMIC_STORE(P, V) __atomic_store_n(P, V, __ATOMIC_RELEASE)
+#define __RESCUE_ATOMIC_CAS(P, E, D) __sync_bool_compare_and_swap(P, E, D)
+#define __RESCUE_ATOMIC_ADD(P, V) __atomic_add_fetch(P, V, __ATOMIC_ACQ_REL)
+#define __RESCUE_ATOMIC_LOAD_POINTER(P) __atomic_load_n(P, __ATOMIC_ACQUIRE)
+#define __RESCUE_ATOMIC_STORE_POINTER(P, V) __atomic_store_n(P, V, __ATOMIC_RELEASE)
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#define __RESCUE_PAUSE() YieldProcessor()
+#define __RESCUE_YIELD() SwitchToThread()
+#else
+#include <sched.h>
+#if defined(__i386__) || defined(__x86_64__)
+#define __RESCUE_PAUSE() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define __RESCUE_PAUSE() __asm__ __volatile__("yield")
+#else
+#define __RESCUE_PAUSE()
+#endif
+#define __RESCUE_YIELD() sched_yield()
+#endif
+#define __RESCUE_SPIN_LIMIT 64
 
 typedef int (*rescue_data_callback)(const void* buffer, int len, void *user);
 
-typedef struct rescue_copy_state {void* buffer; int size; int position; } rescue_copy_state;
+typedef int (*rescue_list_callback)(const char* name, void *user);
+
+typedef void (*rescue_task)(void* context, int task);
 
-int __RESCUE_copy_callback(const void* buffer, int len, void *user)
+typedef void (*rescue_executor)(rescue_task task, void* context, int count, void *user);
+
+#ifndef RESCUE_ITERATOR_DEFINED
+#define RESCUE_ITERATOR_DEFINED
+typedef struct rescue_iterator { int position; int end; } rescue_iterator;
+#endif
+
+#ifndef RESCUE_READER_DEFINED
+#define RESCUE_READER_DEFINED
+typedef struct rescue_reader rescue_reader;
+#endif
+
+typedef struct rescue_range_state { char* buffer; size_t skip; size_t remaining; } rescue_range_state;
+
+typedef struct rescue_parallel_state { int resource; char* buffer; int failed; } rescue_parallel_state;
+
+typedef struct rescue_verify_state { rescue_data_callback callback; void* user; mz_ulong crc; size_t length; } rescue_verify_state;
+
+// Decompression state of a resource that is read on demand, decompressed data that has not been
+// read yet is kept in the window
+#ifndef RESCUE_READER_IMPLEMENTED
+#define RESCUE_READER_IMPLEMENTED
+struct rescue_reader {
+    int resource;
+    int status;
+    size_t position; // Position of the next byte that is read in the uncompressed data
+    const char** segments; // Current segment of the compressed data
+    size_t segment_start; // Offset of the current segment in the compressed data
+    size_t in_buf_ofs;
+    size_t out_buf_ofs; // Data that has not been read yet
+    size_t out_buf_size;
+    size_t dict_ofs;
+    tinfl_decompressor decomp;
+    mz_uint8 window[__RESCUE_CHUNK_SIZE];
+};
+#endif
+
+// Decompressed data of a resource, the references are -1 while the data is being evicted. Cached entries form
+// a ring that is only changed with the lock held, the used flag is set by hits and cleared by the clock hand.
+typedef struct rescue_cache_entry { void* data; long references; long used; int next; int previous; } rescue_cache_entry;
+
+static rescue_cache_entry __RESCUE_cache_entries[__RESCUE_RESOURCE_COUNT + 1];
+static long __RESCUE_cache_lock = 0;
+static int __RESCUE_cache_hand = -1;
+static int __RESCUE_cache_count = 0;
+static long __RESCUE_cache_over = 0;
+static size_t __RESCUE_cache_size = 0;
+static size_t __RESCUE_cache_limit = (size_t) -1;
+static long __RESCUE_verify_enabled = 0;
+
+// Finds the segment that contains the given offset of the data of a resource, contiguous data has a single segment
+const char** __RESCUE_find_segment(int i, size_t* offset)
 {
-    rescue_copy_state* state = (rescue_copy_state *) user;
+    const char** pIn_bufs = __RESCUE_resource_data[i];
 
-    memcpy(&(((char*)state->buffer)[state->position]), buffer, len);
-    state->position += len;
+    if (!pIn_bufs[0] || !pIn_bufs[1])
+        return pIn_bufs;
 
-    return 1;
+    pIn_bufs += *offset / __RESCUE_SEGMENT_LENGTH;
+    *offset %= __RESCUE_SEGMENT_LENGTH;
+
+    return pIn_bufs;
 }
 
-int __RESCUE_inflate_resource(int i, rescue_data_callback callback, void *user)
+// The window starts with the preset dictionary that the resource was compressed with, returns the
+// position in the window after the dictionary
+size_t __RESCUE_seed_dictionary(int i, mz_uint8* pDict)
+{
+    size_t dict_ofs = 0;
+
+#ifdef __RESCUE_DICTIONARY_LENGTH
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_DICTIONARY)
+    {
+        int segment;
+        const char** pDict_bufs = __RESCUE_resource_dictionary;
+        for (segment = 0; pDict_bufs[segment]; segment++)
+        {
+            size_t dict_len = pDict_bufs[segment + 1] ? __RESCUE_SEGMENT_LENGTH : __RESCUE_DICTIONARY_LENGTH - segment * __RESCUE_SEGMENT_LENGTH;
+            memcpy(pDict + dict_ofs, pDict_bufs[segment], dict_len);
+            dict_ofs += dict_len;
+        }
+        dict_ofs &= (__RESCUE_CHUNK_SIZE - 1);
+    }
+#else
+    (void) i;
+    (void) pDict;
+#endif
+
+    return dict_ofs;
+}
+
+// Decompresses a resource starting at the given offset of the compressed data, which has to be either
+// the start of the data or the start of a block that was compressed independently
+int __RESCUE_inflate_blocks(int i, size_t start, rescue_data_callback callback, void *user)
 {
 
     int result = 3;
     int segment = 0;
-    const char** pIn_bufs = __RESCUE_resource_data[i];
+    size_t first = start;
+    const char** pIn_bufs = __RESCUE_find_segment(i, &first);
     tinfl_decompressor decomp;
     mz_uint8 *pDict = (mz_uint8*)malloc(__RESCUE_CHUNK_SIZE); size_t dict_ofs = 0;
     size_t pIn_buf_size;
@@ -56,9 +229,14 @@ int __RESCUE_inflate_resource(int i, rescue_data_callback callback, void *user)
         return 0;
 
     tinfl_init(&decomp);
+
+    // Blocks after the first one do not refer to the preset dictionary
+    if (start == 0)
+        dict_ofs = __RESCUE_seed_dictionary(i, pDict);
+
     for (segment = 0;  ; segment++)
     {
-        size_t in_buf_ofs = 0;
+        size_t in_buf_ofs = segment ? 0 : first;
         mz_uint32 inf_flags = 0;
         const char* pIn_buf = pIn_bufs[segment];
 
@@ -69,7 +247,7 @@ int __RESCUE_inflate_resource(int i, rescue_data_callback callback, void *user)
             pIn_buf_size = __RESCUE_SEGMENT_LENGTH;
         } else {
             inf_flags = 0;
-            pIn_buf_size = __RESCUE_resource_length_deflated[i] - (segment) * __RESCUE_SEGMENT_LENGTH;
+            pIn_buf_size = __RESCUE_resource_length_deflated[i] - (start - first) - (segment) * __RESCUE_SEGMENT_LENGTH;
         }
         for ( ; ; )
         {
@@ -105,110 +283,1131 @@ int __RESCUE_inflate_resource(int i, rescue_data_callback callback, void *user)
     return result;
 }
 
-int __RESCUE_has_resource(const char* name)
+// Length of the chunk of a resource compressed with the fast codec that starts at the given position. Chunks
+// have the length of the window and restart at every block.
+size_t __RESCUE_lz_chunk_length(int i, size_t position)
+{
+    size_t end = __RESCUE_resource_length_inflated[i];
+
+#ifdef __RESCUE_BLOCK_SIZE
+    if ((__RESCUE_resource_metadata[i] & __RESCUE_META_BLOCKS) && end - position > __RESCUE_BLOCK_SIZE - position % __RESCUE_BLOCK_SIZE)
+        end = position - position % __RESCUE_BLOCK_SIZE + __RESCUE_BLOCK_SIZE;
+#endif
+
+    return (end - position > __RESCUE_CHUNK_SIZE) ? __RESCUE_CHUNK_SIZE : end - position;
+}
+
+// Decompresses a chunk of the fast codec, a sequence of literals and matches like an LZ4 block, that has the given length.
+// Returns the length of the compressed chunk or 0 if the data is corrupted. Copies of up to 16 bytes are done at once
+// while they end within the output, matches never refer to data before the start of the output.
+size_t __RESCUE_lz_decode(const mz_uint8* pIn_buf, size_t in_buf_size, mz_uint8* pOut_buf, size_t out_buf_size)
 {
-    int i = 0;
-    while (__RESCUE_resource_names[i])
+    const mz_uint8* pIn = pIn_buf;
+    const mz_uint8* pIn_end = pIn_buf + in_buf_size;
+    mz_uint8* pOut = pOut_buf;
+    mz_uint8* pOut_end = pOut_buf + out_buf_size;
+
+    for ( ; ; )
     {
-        if (strcmp(name, __RESCUE_resource_names[i]) == 0)
+        const mz_uint8* pMatch;
+        size_t length, offset;
+        mz_uint32 token;
+
+        if (pIn >= pIn_end)
+            return 0;
+
+        token = *(pIn++);
+        length = token >> 4;
+
+        if (length < 15 && pIn_end - pIn >= 16 && pOut_end - pOut >= 16)
+        {
+            memcpy(pOut, pIn, 16);
+        } else
+        {
+            if (length == 15)
+            {
+                mz_uint32 extra;
+                do
+                {
+                    if (pIn >= pIn_end)
+                        return 0;
+                    extra = *(pIn++);
+                    length += extra;
+                } while (extra == 255);
+            }
+
+            if (length > (size_t) (pIn_end - pIn) || length > (size_t) (pOut_end - pOut))
+                return 0;
+
+            memcpy(pOut, pIn, length);
+        }
+
+        pIn += length;
+        pOut += length;
+
+        // The last sequence only has literals
+        if (pOut == pOut_end)
+            break;
+
+        if (pIn_end - pIn < 2)
+            return 0;
+
+        offset = pIn[0] | ((size_t) pIn[1] << 8);
+        pIn += 2;
+
+        if (offset == 0 || offset > (size_t) (pOut - pOut_buf))
+            return 0;
+
+        pMatch = pOut - offset;
+        length = token & 15;
+
+        // Most matches are short and copied without a loop
+        if (length < 15 && offset >= 8 && pOut_end - pOut >= 18)
+        {
+            memcpy(pOut, pMatch, 8);
+            memcpy(pOut + 8, pMatch + 8, 8);
+            memcpy(pOut + 16, pMatch + 16, 2);
+            pOut += length + 4;
+            continue;
+        }
+
+        if (length == 15)
         {
-            return 1;
+            mz_uint32 extra;
+            do
+            {
+                if (pIn >= pIn_end)
+                    return 0;
+                extra = *(pIn++);
+                length += extra;
+            } while (extra == 255);
+        }
+
+        length += 4;
+
+        if (length > (size_t) (pOut_end - pOut))
+            return 0;
+
+        if (offset >= 16 && length + 16 <= (size_t) (pOut_end - pOut))
+        {
+            // Copies that are not longer than the offset do not overlap, the last one may write past the
+            // match but not past the output
+            mz_uint8* pCopy_end = pOut + length;
+            do
+            {
+                memcpy(pOut, pMatch, 16);
+                pOut += 16;
+                pMatch += 16;
+            } while (pOut < pCopy_end);
+            pOut = pCopy_end;
+        } else if (offset >= 8 && length + 8 <= (size_t) (pOut_end - pOut))
+        {
+            mz_uint8* pCopy_end = pOut + length;
+            do
+            {
+                memcpy(pOut, pMatch, 8);
+                pOut += 8;
+                pMatch += 8;
+            } while (pOut < pCopy_end);
+            pOut = pCopy_end;
+        } else if (offset == 1)
+        {
+            memset(pOut, *pMatch, length);
+            pOut += length;
+        } else
+        {
+            while (length--)
+                *(pOut++) = *(pMatch++);
         }
-        i++;
     }
-    return 0;
+
+    return (size_t) (pIn - pIn_buf);
 }
 
+// Decompresses the chunks of a resource compressed with the fast codec that start at the given offset of the compressed
+// data and position in the uncompressed data directly to the destination, until it has the given length
+int __RESCUE_unpack_into(int i, size_t start, size_t position, size_t len, mz_uint8* pOut_buf)
+{
+    const mz_uint8* pIn_buf = (const mz_uint8*) __RESCUE_resource_data[i][0];
+    size_t end = position + len;
+
+    while (position < end)
+    {
+        size_t chunk = __RESCUE_lz_chunk_length(i, position);
+        size_t used = (start < __RESCUE_resource_length_deflated[i]) ?
+            __RESCUE_lz_decode(pIn_buf + start, __RESCUE_resource_length_deflated[i] - start, pOut_buf, chunk) : 0;
+
+        if (!used)
+            return 0;
+
+        start += used;
+        position += chunk;
+        pOut_buf += chunk;
+    }
+
+    return 1;
+}
+
+// Same as unpack_into, but every chunk is decompressed to a window and passed to the callback until the end of the resource
+int __RESCUE_unpack_chunks(int i, size_t start, size_t position, rescue_data_callback callback, void *user)
+{
+    const mz_uint8* pIn_buf = (const mz_uint8*) __RESCUE_resource_data[i][0];
+    mz_uint8 *pWindow = (mz_uint8*)malloc(__RESCUE_CHUNK_SIZE);
+    int result = 1;
+
+    if (!pWindow)
+        return 0;
+
+    while (position < __RESCUE_resource_length_inflated[i])
+    {
+        size_t chunk = __RESCUE_lz_chunk_length(i, position);
+        size_t used = (start < __RESCUE_resource_length_deflated[i]) ?
+            __RESCUE_lz_decode(pIn_buf + start, __RESCUE_resource_length_deflated[i] - start, pWindow, chunk) : 0;
+
+        if (!used || !callback(pWindow, (int) chunk, user))
+        {
+            result = 0;
+            break;
+        }
+
+        start += used;
+        position += chunk;
+    }
+
+    free(pWindow);
+
+    return result;
+}
+
+// Decompresses a resource with the codec that it was compressed with
+int __RESCUE_inflate_resource(int i, rescue_data_callback callback, void *user)
+{
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_LZ)
+        return __RESCUE_unpack_chunks(i, 0, 0, callback, user);
+
+    return __RESCUE_inflate_blocks(i, 0, callback, user);
+}
+
+int __RESCUE_stored_resource(int i, rescue_data_callback callback, void *user)
+{
+    int segment;
+    size_t pIn_buf_size;
+    const char** pIn_bufs = __RESCUE_resource_data[i];
+
+    for (segment = 0;  ; segment++)
+    {
+        const char* pIn_buf = pIn_bufs[segment];
+        if (!pIn_buf) break;
+
+        if (pIn_bufs[segment + 1]) {
+            pIn_buf_size = __RESCUE_SEGMENT_LENGTH;
+        } else {
+            pIn_buf_size = __RESCUE_resource_length_inflated[i] - (segment) * __RESCUE_SEGMENT_LENGTH;
+        }
+
+        if (!callback(pIn_buf, (int)pIn_buf_size, user))
+            return 0;
+    }
+
+    return 1;
+}
+
+int __RESCUE_range_callback(const void* buffer, int len, void *user)
+{
+    rescue_range_state* state = (rescue_range_state *) user;
+    size_t available = (size_t) len;
+
+    if (state->skip >= available)
+    {
+        state->skip -= available;
+        return 1;
+    }
+
+    available -= state->skip;
+    if (available > state->remaining)
+        available = state->remaining;
+
+    memcpy(state->buffer, (const char*) buffer + state->skip, available);
+    state->buffer += available;
+    state->remaining -= available;
+    state->skip = 0;
+
+    // Stops decompression once the range is complete
+    return state->remaining > 0;
+}
+
+// Copies a range of a resource that is stored uncompressed, the range has to be within the resource
+void __RESCUE_stored_range(int i, size_t offset, size_t len, char* dst)
+{
+    const char** pIn_bufs = __RESCUE_find_segment(i, &offset);
+
+    while (len > 0)
+    {
+        size_t available = (pIn_bufs[1] ? __RESCUE_SEGMENT_LENGTH : len + offset) - offset;
+        if (available > len)
+            available = len;
+
+        memcpy(dst, *pIn_bufs + offset, available);
+        dst += available;
+        len -= available;
+        offset = 0;
+        pIn_bufs++;
+    }
+}
+
+// Decompresses the compressed data of a resource between the given offsets directly to the destination. The
+// destination is used as the window, so the data must not refer to anything before the start offset.
+int __RESCUE_inflate_into(int i, size_t start, size_t end, int more, mz_uint8* pOut_buf, size_t out_buf_size)
+{
+    tinfl_decompressor decomp;
+    tinfl_status status = TINFL_STATUS_FAILED;
+    size_t position = start, first = start, out_buf_ofs = 0;
+    const char** pIn_bufs = __RESCUE_find_segment(i, &first);
+
+    tinfl_init(&decomp);
+
+    while (position < end)
+    {
+        size_t in_buf_size = pIn_bufs[1] ? __RESCUE_SEGMENT_LENGTH - first : end - position;
+        size_t dst_buf_size = out_buf_size - out_buf_ofs;
+        mz_uint32 inf_flags = TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+
+        if (in_buf_size > end - position)
+            in_buf_size = end - position;
+
+        // Blocks before the last one end with an empty stored block instead of the end of the stream
+        if (position + in_buf_size < end || more)
+            inf_flags |= TINFL_FLAG_HAS_MORE_INPUT;
+
+        status = tinfl_decompress(&decomp, (const mz_uint8*) pIn_bufs[0] + first, &in_buf_size,
+                                  pOut_buf, pOut_buf + out_buf_ofs, &dst_buf_size, inf_flags);
+        position += in_buf_size;
+        first += in_buf_size;
+        out_buf_ofs += dst_buf_size;
+
+        if (status < 0 || status == TINFL_STATUS_DONE || out_buf_ofs == out_buf_size)
+            break;
+
+        if (pIn_bufs[1] && first == __RESCUE_SEGMENT_LENGTH)
+        {
+            pIn_bufs++;
+            first = 0;
+        }
+    }
+
+    return status >= 0 && out_buf_ofs == out_buf_size;
+}
+
+// Compares the CRC of the decompressed data of a resource to the one recorded by the compiler if verification is enabled
+int __RESCUE_verify_resource(int i, const void* data)
+{
+    if (!__RESCUE_ATOMIC_LOAD(&__RESCUE_verify_enabled))
+        return 1;
+
+    return (mz_uint32) mz_crc32(MZ_CRC32_INIT, (const mz_uint8*) data, __RESCUE_resource_length_inflated[i]) == __RESCUE_resource_crc[i];
+}
+
+// Decompresses a resource to a buffer of its uncompressed length. The data is decompressed directly to the
+// buffer, which is used as the window, unless the preset dictionary has to be in the window before the data.
+int __RESCUE_decode_resource(int i, char* buffer)
+{
+    int result;
+
+    if (!(__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION))
+    {
+        __RESCUE_stored_range(i, 0, __RESCUE_resource_length_inflated[i], buffer);
+        result = 1;
+    }
+    else if (__RESCUE_resource_metadata[i] & __RESCUE_META_LZ)
+        result = __RESCUE_unpack_into(i, 0, 0, __RESCUE_resource_length_inflated[i], (mz_uint8*) buffer);
+#ifdef __RESCUE_DICTIONARY_LENGTH
+    else if (__RESCUE_resource_metadata[i] & __RESCUE_META_DICTIONARY)
+    {
+        rescue_range_state state;
+        state.buffer = buffer;
+        state.skip = 0;
+        state.remaining = __RESCUE_resource_length_inflated[i];
+        __RESCUE_inflate_blocks(i, 0, &__RESCUE_range_callback, &state);
+        result = state.remaining == 0;
+    }
+#endif
+    else
+        result = __RESCUE_inflate_into(i, 0, __RESCUE_resource_length_deflated[i], 0, (mz_uint8*) buffer, __RESCUE_resource_length_inflated[i]);
+
+    return result && __RESCUE_verify_resource(i, buffer);
+}
+
+mz_uint32 __RESCUE_name_hash(mz_uint32 seed, const char* name)
+{
+    mz_uint32 hash = (2166136261u ^ seed) * 16777619u;
+
+    while (*name)
+    {
+        hash ^= (unsigned char) *(name++);
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    hash ^= hash >> 12;
+
+    return hash;
+}
+
+// Finds a resource using the perfect hash generated by the compiler, returns -1 if there is no such resource
+int __RESCUE_find_resource(const char* name)
+{
+#if __RESCUE_HASH_SLOTS > 0
+    int slot, i;
+    int displacement = __RESCUE_resource_displacement[__RESCUE_name_hash(0, name) % __RESCUE_HASH_BUCKETS];
+
+    if (displacement < 0)
+        slot = -displacement - 1;
+    else
+        slot = (int) (__RESCUE_name_hash((mz_uint32) displacement, name) % __RESCUE_HASH_SLOTS);
+
+    i = __RESCUE_resource_slots[slot];
+
+    if (strcmp(name, __RESCUE_resource_names[i]) == 0)
+        return i;
+#endif
+
+    return -1;
+}
+
+int __RESCUE_has_resource(const char* name)
+{
+    return __RESCUE_find_resource(name) >= 0;
+}
+
+// Updates the CRC of the data that is passed to the callback of get_resource
+int __RESCUE_verify_callback(const void* buffer, int len, void *user)
+{
+    rescue_verify_state* state = (rescue_verify_state *) user;
+
+    state->crc = mz_crc32(state->crc, (const mz_uint8*) buffer, (size_t) len);
+    state->length += (size_t) len;
+
+    return state->callback(buffer, len, state->user);
+}
+
+// Returns 0 if verification is enabled and the data does not match, which is only known after the callback got all of it
 int __RESCUE_get_resource(const char* name, rescue_data_callback callback, void *user)
 {
-    int i = 0;
-    while (__RESCUE_resource_names[i])
+    rescue_verify_state state;
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return 0;
+
+    state.callback = callback;
+    state.user = user;
+    state.crc = MZ_CRC32_INIT;
+    state.length = 0;
+
+    if (__RESCUE_ATOMIC_LOAD(&__RESCUE_verify_enabled))
+    {
+        callback = &__RESCUE_verify_callback;
+        user = &state;
+    }
+
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION) {
+        __RESCUE_inflate_resource(i, callback, user);
+    } else {
+        __RESCUE_stored_resource(i, callback, user);
+    }
+
+    // A callback that stops early does not get all data, so there is nothing to compare
+    if (user == &state && state.length == __RESCUE_resource_length_inflated[i])
+        return (mz_uint32) state.crc == __RESCUE_resource_crc[i];
+
+    return 1;
+}
+
+int __RESCUE_copy_resource(const char* name, char** buffer, size_t* size)
+{
+
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return 0;
+
+    *size = __RESCUE_resource_length_inflated[i];
+    *buffer = (char*) malloc(sizeof(char) * (*size));
+
+    if (!*buffer && *size > 0)
+        return 0;
+
+    // The length is known, so the data is decompressed directly to the buffer instead of through a window
+    if (!__RESCUE_decode_resource(i, *buffer))
+    {
+        free(*buffer);
+        *buffer = NULL;
+        return 0;
+    }
+
+    return 1;
+
+}
+
+int __RESCUE_get_length(const char* name, size_t* compressed, size_t* uncompressed)
+{
+
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return 0;
+
+    if (compressed)
+        *compressed = __RESCUE_resource_length_deflated[i];
+
+    if (uncompressed)
+        *uncompressed = __RESCUE_resource_length_inflated[i];
+
+    return 1;
+
+}
+
+// Data of a resource that is stored uncompressed in a single array, it can be used without copying
+int __RESCUE_get_pointer(const char* name, const void** pointer, size_t* length)
+{
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0 || (__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION) || !(__RESCUE_resource_metadata[i] & __RESCUE_META_CONTIGUOUS))
+        return 0;
+
+    *pointer = __RESCUE_resource_data[i][0];
+
+    if (length)
+        *length = __RESCUE_resource_length_inflated[i];
+
+    return 1;
+}
+
+// Reads a range of the uncompressed data of a resource. Resources compressed in blocks are only
+// decompressed from the start of the block that contains the offset, other compressed resources from their start.
+int __RESCUE_read_range(const char* name, size_t offset, size_t len, void* buffer)
+{
+    rescue_range_state state;
+    size_t start = 0, position = 0;
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0 || offset > __RESCUE_resource_length_inflated[i] || len > __RESCUE_resource_length_inflated[i] - offset)
+        return 0;
+
+    if (len == 0)
+        return 1;
+
+    if (!(__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION))
+    {
+        __RESCUE_stored_range(i, offset, len, (char*) buffer);
+        return 1;
+    }
+
+    state.buffer = (char*) buffer;
+    state.skip = offset;
+    state.remaining = len;
+
+#ifdef __RESCUE_BLOCK_SIZE
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_BLOCKS)
     {
-        if (strcmp(name, __RESCUE_resource_names[i]) == 0)
+        size_t block = offset / __RESCUE_BLOCK_SIZE;
+        start = __RESCUE_resource_blocks[__RESCUE_resource_block_index[i] + block];
+        position = block * __RESCUE_BLOCK_SIZE;
+        state.skip = offset - position;
+    }
+#endif
+
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_LZ)
+        __RESCUE_unpack_chunks(i, start, position, &__RESCUE_range_callback, &state);
+    else
+        __RESCUE_inflate_blocks(i, start, &__RESCUE_range_callback, &state);
+
+    return state.remaining == 0;
+}
+
+// Restarts decompression at the given offset of the compressed data, either the start of the data
+// or the start of a block
+void __RESCUE_reader_start(rescue_reader* reader, size_t start, size_t position)
+{
+    size_t first = start;
+
+    reader->segments = __RESCUE_find_segment(reader->resource, &first);
+    reader->segment_start = start - first;
+    reader->in_buf_ofs = first;
+    reader->out_buf_ofs = 0;
+    reader->out_buf_size = 0;
+    reader->position = position;
+    reader->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    reader->dict_ofs = (start == 0) ? __RESCUE_seed_dictionary(reader->resource, reader->window) : 0;
+
+    tinfl_init(&reader->decomp);
+}
+
+// Opens a resource for reading, returns NULL if there is no such resource
+rescue_reader* __RESCUE_open(const char* name)
+{
+    rescue_reader* reader;
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return NULL;
+
+    reader = (rescue_reader*) malloc(sizeof(rescue_reader));
+
+    if (!reader)
+        return NULL;
+
+    reader->resource = i;
+    __RESCUE_reader_start(reader, 0, 0);
+
+    return reader;
+}
+
+// Decompresses until there is data in the window that has not been read, returns 0 at the end of the data
+int __RESCUE_reader_fill(rescue_reader* reader)
+{
+    int i = reader->resource;
+
+    while (reader->out_buf_size == 0)
+    {
+        const char** pIn_bufs = reader->segments;
+        size_t in_buf_size, dst_buf_size = __RESCUE_CHUNK_SIZE - reader->dict_ofs;
+        mz_uint32 inf_flags = 0;
+        tinfl_status status;
+
+        if (reader->status == TINFL_STATUS_DONE || reader->status < 0 || !pIn_bufs[0])
+            return 0;
+
+        // Chunks of the fast codec have at most the length of the window and are decompressed at once
+        if (__RESCUE_resource_metadata[i] & __RESCUE_META_LZ)
         {
-            if (__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION) {
-                __RESCUE_inflate_resource(i, callback, user);
-            } else {
-                callback(__RESCUE_resource_data[i], __RESCUE_resource_length_deflated[i], user);
+            size_t start = reader->segment_start + reader->in_buf_ofs, chunk, used = 0;
+
+            if (reader->position >= __RESCUE_resource_length_inflated[i])
+                return 0;
+
+            chunk = __RESCUE_lz_chunk_length(i, reader->position);
+            if (start < __RESCUE_resource_length_deflated[i])
+                used = __RESCUE_lz_decode((const mz_uint8*) __RESCUE_resource_data[i][0] + start, __RESCUE_resource_length_deflated[i] - start, reader->window, chunk);
+
+            if (!used)
+            {
+                reader->status = TINFL_STATUS_FAILED;
+                return 0;
             }
 
-            return 1;
+            reader->in_buf_ofs += used;
+            reader->out_buf_ofs = 0;
+            reader->out_buf_size = chunk;
+            continue;
+        }
+
+        if (pIn_bufs[1]) {
+            inf_flags = TINFL_FLAG_HAS_MORE_INPUT;
+            in_buf_size = __RESCUE_SEGMENT_LENGTH - reader->in_buf_ofs;
+        } else {
+            in_buf_size = __RESCUE_resource_length_deflated[i] - reader->segment_start - reader->in_buf_ofs;
+        }
+
+        status = tinfl_decompress(&reader->decomp, (const mz_uint8*) pIn_bufs[0] + reader->in_buf_ofs, &in_buf_size,
+                                  reader->window, reader->window + reader->dict_ofs, &dst_buf_size, inf_flags);
+        reader->in_buf_ofs += in_buf_size;
+        reader->out_buf_ofs = reader->dict_ofs;
+        reader->out_buf_size = dst_buf_size;
+        reader->dict_ofs = (reader->dict_ofs + dst_buf_size) & (__RESCUE_CHUNK_SIZE - 1);
+        reader->status = status;
+
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT && pIn_bufs[1] && reader->in_buf_ofs == __RESCUE_SEGMENT_LENGTH)
+        {
+            reader->segments++;
+            reader->segment_start += __RESCUE_SEGMENT_LENGTH;
+            reader->in_buf_ofs = 0;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT && !pIn_bufs[1] && dst_buf_size == 0)
+        {
+            // The data ends before the end of the stream
+            reader->status = TINFL_STATUS_FAILED;
         }
-        i++;
     }
-    return 0;
+
+    return 1;
 }
 
-int __RESCUE_copy_resource(const char* name, char** buffer, size_t* size)
+// Reads up to the given number of bytes, returns the number of bytes read which is smaller
+// only at the end of the resource or if the data is corrupted
+size_t __RESCUE_read(rescue_reader* reader, void* buffer, size_t len)
+{
+    int i = reader->resource;
+    size_t total = 0;
+
+    if (len > __RESCUE_resource_length_inflated[i] - reader->position)
+        len = __RESCUE_resource_length_inflated[i] - reader->position;
+
+    if (!(__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION))
+    {
+        __RESCUE_stored_range(i, reader->position, len, (char*) buffer);
+        reader->position += len;
+        return len;
+    }
+
+    while (total < len && __RESCUE_reader_fill(reader))
+    {
+        size_t available = reader->out_buf_size;
+
+        if (available > len - total)
+            available = len - total;
+
+        if (buffer)
+            memcpy((char*) buffer + total, reader->window + reader->out_buf_ofs, available);
+
+        reader->out_buf_ofs += available;
+        reader->out_buf_size -= available;
+        reader->position += available;
+        total += available;
+    }
+
+    return total;
+}
+
+// Skips the given number of bytes, resources compressed in blocks continue decompression at the block
+// that contains the new position. Returns the number of bytes skipped.
+size_t __RESCUE_skip(rescue_reader* reader, size_t len)
 {
+    int i = reader->resource;
+
+    if (len > __RESCUE_resource_length_inflated[i] - reader->position)
+        len = __RESCUE_resource_length_inflated[i] - reader->position;
 
-    int i = 0;
-    while (__RESCUE_resource_names[i])
+    if (!(__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION))
     {
-        if (strcmp(name, __RESCUE_resource_names[i]) == 0)
+        reader->position += len;
+        return len;
+    }
+
+#ifdef __RESCUE_BLOCK_SIZE
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_BLOCKS)
+    {
+        size_t target = reader->position + len;
+        size_t block = target / __RESCUE_BLOCK_SIZE;
+
+        // Data in the window belongs to the block of the current position, later blocks can be started directly
+        if (block > reader->position / __RESCUE_BLOCK_SIZE)
         {
-            rescue_copy_state state;
-            *size = __RESCUE_resource_length_inflated[i];
-            *buffer = (char*) malloc(sizeof(char) * (*size));
-            state.buffer = *buffer;
-            state.position = 0;
-            state.size = *size;
+            __RESCUE_reader_start(reader, __RESCUE_resource_blocks[__RESCUE_resource_block_index[i] + block], block * __RESCUE_BLOCK_SIZE);
+            return len - (target - reader->position) + __RESCUE_read(reader, NULL, target - reader->position);
+        }
+    }
+#endif
 
-            if (__RESCUE_resource_metadata[i] & __RESCUE_META_COMPRESSION) {
+    return __RESCUE_read(reader, NULL, len);
+}
 
-                __RESCUE_inflate_resource(i, &__RESCUE_copy_callback, &state);
+// Starts reading another resource with an existing reader, which avoids allocating a new one. Returns 0
+// if there is no such resource.
+int __RESCUE_reopen(rescue_reader* reader, const char* name)
+{
+    int i = __RESCUE_find_resource(name);
 
-            } else {
-                int segment;
-                size_t pIn_buf_size;
-                const char** pIn_bufs = __RESCUE_resource_data[i];
-                for (segment = 0;  ; segment++)
-                {
-                    size_t in_buf_ofs = 0;
-                    const char* pIn_buf = pIn_bufs[segment];
-                    if (!pIn_buf) break;
+    if (i < 0)
+        return 0;
 
-                    if (pIn_bufs[segment + 1]) {
-                        pIn_buf_size = __RESCUE_SEGMENT_LENGTH;
-                    } else {
-                        pIn_buf_size = __RESCUE_resource_length_inflated[i] - (segment) * __RESCUE_SEGMENT_LENGTH;
-                    }
+    reader->resource = i;
+    __RESCUE_reader_start(reader, 0, 0);
 
-                    __RESCUE_copy_callback(pIn_buf, pIn_buf_size, &state);
+    return 1;
+}
 
-                }
-            }
+void __RESCUE_close(rescue_reader* reader)
+{
+    free(reader);
+}
 
-            return 1;
+// Decompresses a resource to a buffer provided by the caller without allocating memory. Returns 0 if the
+// resource does not exist or is larger than the capacity, the length is set in both cases if it exists.
+int __RESCUE_copy_into(const char* name, void* buffer, size_t capacity, size_t* length)
+{
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return 0;
+
+    if (length)
+        *length = __RESCUE_resource_length_inflated[i];
+
+    if (__RESCUE_resource_length_inflated[i] > capacity)
+        return 0;
+
+    return __RESCUE_decode_resource(i, (char*) buffer);
+}
+
+#ifdef __RESCUE_BLOCK_SIZE
+// Decompresses a block of a resource compressed in blocks directly to its position in the destination.
+// Blocks do not refer to data before their start, so the destination can be used as the window.
+int __RESCUE_inflate_block(int i, int block, char* destination)
+{
+    int index = __RESCUE_resource_block_index[i] + block;
+    size_t count = (__RESCUE_resource_length_inflated[i] + __RESCUE_BLOCK_SIZE - 1) / __RESCUE_BLOCK_SIZE;
+    size_t end = ((size_t) block + 1 < count) ? __RESCUE_resource_blocks[index + 1] : __RESCUE_resource_length_deflated[i];
+    size_t out_buf_size = __RESCUE_resource_length_inflated[i] - (size_t) block * __RESCUE_BLOCK_SIZE;
+
+    if (out_buf_size > __RESCUE_BLOCK_SIZE)
+        out_buf_size = __RESCUE_BLOCK_SIZE;
+
+    if (__RESCUE_resource_metadata[i] & __RESCUE_META_LZ)
+        return __RESCUE_unpack_into(i, __RESCUE_resource_blocks[index], (size_t) block * __RESCUE_BLOCK_SIZE, out_buf_size,
+            (mz_uint8*) destination + (size_t) block * __RESCUE_BLOCK_SIZE);
+
+#ifdef __RESCUE_DICTIONARY_LENGTH
+    // The first block can refer to the preset dictionary
+    if (block == 0 && (__RESCUE_resource_metadata[i] & __RESCUE_META_DICTIONARY))
+    {
+        rescue_range_state state;
+        state.buffer = destination;
+        state.skip = 0;
+        state.remaining = out_buf_size;
+        __RESCUE_inflate_blocks(i, 0, &__RESCUE_range_callback, &state);
+        return state.remaining == 0;
+    }
+#endif
+
+    return __RESCUE_inflate_into(i, __RESCUE_resource_blocks[index], end, (size_t) block + 1 < count,
+        (mz_uint8*) destination + (size_t) block * __RESCUE_BLOCK_SIZE, out_buf_size);
+}
+
+void __RESCUE_parallel_task(void* context, int task)
+{
+    rescue_parallel_state* state = (rescue_parallel_state *) context;
+
+    if (!__RESCUE_inflate_block(state->resource, task, state->buffer))
+        state->failed = 1;
+}
+#endif
+
+// Same as copy_resource, but the blocks of resources compressed in blocks are decompressed by tasks that
+// the executor can run in parallel. The executor has to call the task for every index below the count
+// and return once all of them are finished. Other resources are decompressed on the calling thread.
+int __RESCUE_copy_resource_parallel(const char* name, char** buffer, size_t* size, rescue_executor executor, void *user)
+{
+#ifdef __RESCUE_BLOCK_SIZE
+    rescue_parallel_state state;
+    int i = __RESCUE_find_resource(name);
+
+    if (i >= 0 && executor && (__RESCUE_resource_metadata[i] & __RESCUE_META_BLOCKS))
+    {
+        int count = (int) ((__RESCUE_resource_length_inflated[i] + __RESCUE_BLOCK_SIZE - 1) / __RESCUE_BLOCK_SIZE);
+
+        *size = __RESCUE_resource_length_inflated[i];
+        *buffer = (char*) malloc(sizeof(char) * (*size));
+
+        if (!*buffer)
+            return 0;
+
+        state.resource = i;
+        state.buffer = *buffer;
+        state.failed = 0;
+
+        executor(&__RESCUE_parallel_task, &state, count, user);
+
+        if (state.failed || !__RESCUE_verify_resource(i, *buffer))
+        {
+            free(*buffer);
+            *buffer = NULL;
+            return 0;
         }
-        i++;
+
+        return 1;
     }
+#else
+    (void) executor;
+    (void) user;
+#endif
+
+    return __RESCUE_copy_resource(name, buffer, size);
+}
+
+// The lock is only taken when the cache changes, it is never held while decompressing. A waiting thread spins
+// briefly and then gives up the processor, as the holder may be freeing several entries.
+void __RESCUE_cache_enter()
+{
+    int spins = 0;
 
-    return 0;
+    while (__RESCUE_ATOMIC_LOAD(&__RESCUE_cache_lock) != 0 || !__RESCUE_ATOMIC_CAS(&__RESCUE_cache_lock, 0, 1))
+    {
+        if (spins < __RESCUE_SPIN_LIMIT)
+        {
+            __RESCUE_PAUSE();
+            spins++;
+        } else
+        {
+            __RESCUE_YIELD();
+        }
+    }
+}
 
+void __RESCUE_cache_leave()
+{
+    __RESCUE_ATOMIC_STORE(&__RESCUE_cache_lock, 0);
 }
 
-int __RESCUE_get_length(const char* name, size_t* compressed, size_t* uncompressed)
+// Adds an entry to the ring just behind the hand, so that it is the last one that the hand reaches
+void __RESCUE_cache_insert(int i)
 {
+    rescue_cache_entry* entry = &__RESCUE_cache_entries[i];
 
-    int i = 0;
-    while (__RESCUE_resource_names[i])
+    if (__RESCUE_cache_hand < 0)
     {
-        if (strcmp(name, __RESCUE_resource_names[i]) == 0)
+        entry->next = i;
+        entry->previous = i;
+        __RESCUE_cache_hand = i;
+    } else
+    {
+        entry->next = __RESCUE_cache_hand;
+        entry->previous = __RESCUE_cache_entries[__RESCUE_cache_hand].previous;
+        __RESCUE_cache_entries[entry->previous].next = i;
+        __RESCUE_cache_entries[__RESCUE_cache_hand].previous = i;
+    }
+
+    __RESCUE_cache_count++;
+}
+
+void __RESCUE_cache_remove(int i)
+{
+    rescue_cache_entry* entry = &__RESCUE_cache_entries[i];
+
+    if (entry->next == i)
+    {
+        __RESCUE_cache_hand = -1;
+    } else
+    {
+        __RESCUE_cache_entries[entry->previous].next = entry->next;
+        __RESCUE_cache_entries[entry->next].previous = entry->previous;
+
+        if (__RESCUE_cache_hand == i)
+            __RESCUE_cache_hand = entry->next;
+    }
+
+    __RESCUE_cache_count--;
+}
+
+// Frees entries that are not referenced until the cache fits in the budget, called with the lock held. The hand
+// gives entries that were used since it passed them a second chance, so an eviction costs O(1) amortised.
+// Entries that are referenced stay in the cache even if it is over budget.
+void __RESCUE_cache_trim()
+{
+    int passed = 0;
+
+    // Two rounds without an eviction clear every used flag, after that only referenced entries remain
+    while (__RESCUE_cache_size > __RESCUE_cache_limit && __RESCUE_cache_hand >= 0 && passed < 2 * __RESCUE_cache_count)
+    {
+        int i = __RESCUE_cache_hand;
+        rescue_cache_entry* entry = &__RESCUE_cache_entries[i];
+        void* data;
+
+        __RESCUE_cache_hand = entry->next;
+        passed++;
+
+        if (__RESCUE_ATOMIC_LOAD(&entry->references) != 0)
+            continue;
+
+        if (__RESCUE_ATOMIC_LOAD(&entry->used))
         {
-            if (compressed)
-                *compressed = __RESCUE_resource_length_deflated[i];
+            __RESCUE_ATOMIC_STORE(&entry->used, 0);
+            continue;
+        }
+
+        // Fails if a reader has acquired the entry since it was checked
+        if (!__RESCUE_ATOMIC_CAS(&entry->references, 0, -1))
+            continue;
+
+        data = entry->data;
+        __RESCUE_ATOMIC_STORE_POINTER(&entry->data, NULL);
+        __RESCUE_ATOMIC_STORE(&entry->references, 0);
+        __RESCUE_cache_remove(i);
+        __RESCUE_cache_size -= __RESCUE_resource_length_inflated[i];
+        free((char*) data - __RESCUE_CACHE_HEADER);
+        passed = 0;
+    }
 
-            if (uncompressed)
-                *uncompressed = __RESCUE_resource_length_inflated[i];
+    __RESCUE_ATOMIC_STORE(&__RESCUE_cache_over, __RESCUE_cache_size > __RESCUE_cache_limit);
+}
+
+// Returns the decompressed data of a resource that stays valid until it is released. Every resource is only
+// decompressed once while it is in the cache, finding a cached resource does not take a lock. A hit and its
+// release still update the reference count of the entry atomically, so threads that acquire the same resource
+// at a high rate contend on that count.
+const void* __RESCUE_acquire(const char* name, size_t* size)
+{
+    rescue_cache_entry* entry;
+    char* block;
+    void* data;
+    int i = __RESCUE_find_resource(name);
+
+    if (i < 0)
+        return NULL;
+
+    entry = &__RESCUE_cache_entries[i];
+
+    while (1)
+    {
+        long references = __RESCUE_ATOMIC_LOAD(&entry->references);
 
-            return 1;
+        if (references < 0)
+            break;
+
+        if (!__RESCUE_ATOMIC_CAS(&entry->references, references, references + 1))
+            continue;
+
+        data = __RESCUE_ATOMIC_LOAD_POINTER(&entry->data);
+
+        if (!data)
+        {
+            __RESCUE_ATOMIC_ADD(&entry->references, -1);
+            break;
         }
-        i++;
+
+        // The flag is only written after the clock hand has cleared it
+        if (!__RESCUE_ATOMIC_LOAD(&entry->used))
+            __RESCUE_ATOMIC_STORE(&entry->used, 1);
+
+        if (size)
+            *size = __RESCUE_resource_length_inflated[i];
+
+        return data;
+    }
+
+    // The data starts with the index of the resource so that it can be released
+    block = (char*) malloc(__RESCUE_CACHE_HEADER + __RESCUE_resource_length_inflated[i]);
+
+    if (!block)
+        return NULL;
+
+    *((int*) block) = i;
+
+    if (!__RESCUE_decode_resource(i, block + __RESCUE_CACHE_HEADER))
+    {
+        free(block);
+        return NULL;
+    }
+
+    __RESCUE_cache_enter();
+
+    data = entry->data;
+
+    if (data)
+    {
+        // Another thread has added the resource in the meantime
+        __RESCUE_ATOMIC_ADD(&entry->references, 1);
+        __RESCUE_cache_leave();
+        free(block);
+    } else
+    {
+        data = block + __RESCUE_CACHE_HEADER;
+        __RESCUE_ATOMIC_ADD(&entry->references, 1);
+        __RESCUE_ATOMIC_STORE(&entry->used, 0);
+        __RESCUE_ATOMIC_STORE_POINTER(&entry->data, data);
+        __RESCUE_cache_insert(i);
+        __RESCUE_cache_size += __RESCUE_resource_length_inflated[i];
+        __RESCUE_cache_trim();
+        __RESCUE_cache_leave();
+    }
+
+    if (size)
+        *size = __RESCUE_resource_length_inflated[i];
+
+    return data;
+}
+
+void __RESCUE_release(const void* data)
+{
+    int i;
+
+    if (!data)
+        return;
+
+    i = *((const int*) ((const char*) data - __RESCUE_CACHE_HEADER));
+
+    // Entries are only evicted on release if the cache is over budget
+    if (__RESCUE_ATOMIC_ADD(&__RESCUE_cache_entries[i].references, -1) == 0 && __RESCUE_ATOMIC_LOAD(&__RESCUE_cache_over))
+    {
+        __RESCUE_cache_enter();
+        __RESCUE_cache_trim();
+        __RESCUE_cache_leave();
+    }
+}
+
+// Sets the maximal size of the decompressed data in the cache, the default is unlimited. A budget of 0 frees
+// all entries that are not referenced.
+void __RESCUE_set_cache_budget(size_t bytes)
+{
+    __RESCUE_cache_enter();
+    __RESCUE_cache_limit = bytes;
+    __RESCUE_cache_trim();
+    __RESCUE_cache_leave();
+}
+
+// Enables checking the CRC that the compiler recorded for every resource when a resource is decompressed as a
+// whole, by get_resource and everything that decompresses to a buffer. Ranges and readers are not checked.
+void __RESCUE_set_verify(int enabled)
+{
+    __RESCUE_ATOMIC_STORE(&__RESCUE_verify_enabled, enabled ? 1 : 0);
+}
+
+// Position of the first name in sorted order that is not less than the prefix (or does not start with it)
+int __RESCUE_list_bound(const char* prefix, int after)
+{
+    int low = 0, high = __RESCUE_HASH_SLOTS;
+    size_t len = strlen(prefix);
+
+    while (low < high)
+    {
+        int middle = low + (high - low) / 2;
+        const char* name = __RESCUE_resource_names[__RESCUE_resource_sorted[middle]];
+        int result = after ? strncmp(name, prefix, len) : strcmp(name, prefix);
+
+        if (result < 0 || (after && result == 0))
+            low = middle + 1;
+        else
+            high = middle;
     }
 
-    return 0;
+    return low;
+}
+
+int __RESCUE_list_begin(const char* prefix, rescue_iterator* iterator)
+{
+    if (!prefix)
+        prefix = "";
+
+    iterator->position = __RESCUE_list_bound(prefix, 0);
+    iterator->end = __RESCUE_list_bound(prefix, 1);
+
+    return iterator->end - iterator->position;
+}
+
+const char* __RESCUE_list_next(rescue_iterator* iterator)
+{
+    if (iterator->position >= iterator->end)
+        return NULL;
+
+    return __RESCUE_resource_names[__RESCUE_resource_sorted[iterator->position++]];
+}
+
+int __RESCUE_list(const char* prefix, rescue_list_callback callback, void *user)
+{
+    rescue_iterator iterator;
+    const char* name;
+    int count = 0;
+
+    __RESCUE_list_begin(prefix, &iterator);
+
+    while ((name = __RESCUE_list_next(&iterator)) != NULL)
+    {
+        count++;
+        if (!callback(name, user))
+            break;
+    }
 
+    return count;
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,73 @@
+#!/bin/sh
+# Generates a source file with every data encoding of rescue for the given inputs and reports its size and the
+# time and peak memory that the C compilers need to compile it.
+#
+# Usage: tools/measure-encodings.sh <rescue> <file|dir>...
+#
+# The compilers are taken from the COMPILERS variable (default "gcc clang"), the ones that are not installed are
+# skipped. Peak memory needs GNU time or BSD time (/usr/bin/time), without it only the time is reported.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <rescue> <file|dir>..." >&2
+    exit 1
+fi
+
+RESCUE=$1
+shift
+COMPILERS=${COMPILERS:-"gcc clang"}
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/rescue-measure.XXXXXX") || exit 1
+trap 'rm -rf "$WORK"' EXIT
+
+if /usr/bin/time -f "%e %M" -o "$WORK/probe" true 2>/dev/null; then
+    TIMER=gnu
+elif /usr/bin/time -l true >/dev/null 2>&1; then
+    TIMER=bsd
+else
+    TIMER=none
+fi
+
+# Prints the elapsed seconds and the peak resident memory in KB of the command, or "failed"
+measure()
+{
+    case $TIMER in
+    gnu)
+        /usr/bin/time -f "%e %M" -o "$WORK/time" "$@" >/dev/null 2>&1 || { echo failed; return; }
+        tail -n 1 "$WORK/time"
+        ;;
+    bsd)
+        /usr/bin/time -l "$@" >/dev/null 2>"$WORK/time" || { echo failed; return; }
+        # macOS reports the memory in bytes, the other BSDs in KB
+        awk -v bytes="$([ "$(uname)" = Darwin ] && echo 1 || echo 0)" \
+            '/ real / { seconds = $1 } /maximum resident set size/ { memory = bytes ? int($1 / 1024) : $1 }
+             END { print seconds, memory }' "$WORK/time"
+        ;;
+    *)
+        start=$(date +%s%N)
+        "$@" >/dev/null 2>&1 || { echo failed; return; }
+        end=$(date +%s%N)
+        awk -v start="$start" -v end="$end" 'BEGIN { printf "%.2f -\n", (end - start) / 1e9 }'
+        ;;
+    esac
+}
+
+printf "%-8s %12s %-8s %10s %12s\n" encoding "source bytes" compiler seconds "peak KB"
+
+for encoding in string minimal hex decimal embed; do
+    source="$WORK/$encoding.c"
+
+    if ! "$RESCUE" -e "$encoding" -o "$source" "$@" 2>/dev/null; then
+        printf "%-8s %12s\n" "$encoding" failed
+        continue
+    fi
+
+    # The embed encoding writes the data to a .bin file next to the source, which is counted as well
+    size=$(cat "$WORK/$encoding".* | wc -c)
+    standard=
+    [ "$encoding" = embed ] && standard=-std=c2x
+
+    for compiler in $COMPILERS; do
+        command -v "$compiler" >/dev/null 2>&1 || continue
+        result=$(measure "$compiler" $standard -c "$source" -o "$WORK/$encoding.o")
+        printf "%-8s %12s %-8s %10s %12s\n" "$encoding" "$size" "$compiler" $result
+    done
+done